@@ -0,0 +1,220 @@
+/*
+  ==============================================================================
+
+    Headless batch analyzer: runs AnalysisEngine over files, folders or a
+    manifest and writes one JSON line or CSV row per track. Links no GUI modules.
+
+  ==============================================================================
+*/
+
+#include "AnalysisEngine.h"
+#include "AnalysisReport.h"
+#include <JuceHeader.h>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    void printUsage()
+    {
+        std::cout << "Usage: AudioAnalyzerCli [options] <file|folder>...\n"
+                     "\n"
+                     "  --manifest <file>    Read input paths from a text file, one per line\n"
+                     "  --format json|csv    Record format (default: json, one object per line)\n"
+                     "  --output <file>      Write records to a file instead of stdout\n"
+                     "  --jobs <n>           Files analyzed at the same time (default: one per pool worker)\n"
+                     "  --spectrum           Include the averaged stereo spectrum in JSON records\n"
+                     "  --loudest-section    Build the spectrum from the loudest 20 s only (quick look)\n"
+                     "  --essentia           Use the Essentia tools the plugin extracted instead of the native\n"
+                     "                       estimators (Windows only)\n"
+                     "  --scratch <folder>   Scratch folder for the Essentia tools' intermediate files\n";
+    }
+
+    void addInput(const juce::File& input, const juce::String& wildcard, juce::Array<juce::File>& files)
+    {
+        if (input.isDirectory())
+        {
+            auto found = input.findChildFiles(juce::File::findFiles, true, wildcard);
+            found.sort();
+            files.addArray(found);
+        }
+        else if (input.existsAsFile())
+        {
+            files.add(input);
+        }
+        else
+        {
+            std::cerr << "Skipping missing input: " << input.getFullPathName() << "\n";
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ArgumentList args(argc, argv);
+
+    if (args.size() == 0 || args.containsOption("--help|-h"))
+    {
+        printUsage();
+
+        return 0;
+    }
+
+    juce::String format = args.containsOption("--format") ? args.removeValueForOption("--format") : juce::String("json");
+    juce::String outputPath = args.containsOption("--output") ? args.removeValueForOption("--output") : juce::String();
+    juce::String manifestPath = args.containsOption("--manifest") ? args.removeValueForOption("--manifest") : juce::String();
+    juce::String scratchPath = args.containsOption("--scratch") ? args.removeValueForOption("--scratch") : juce::String();
+    // Runners only wait while the pool computes, so one file per pool worker keeps every core busy
+    juce::SharedResourcePointer<AnalysisThreadPool> pool;
+    int numJobs = args.containsOption("--jobs") ? args.removeValueForOption("--jobs").getIntValue() : pool->getNumWorkers();
+    bool includeSpectrum = args.removeOptionIfFound("--spectrum");
+    bool loudestSectionOnly = args.removeOptionIfFound("--loudest-section");
+    bool useEssentia = args.removeOptionIfFound("--essentia");
+
+   #if ! JUCE_WINDOWS
+    if (useEssentia)
+    {
+        std::cerr << "--essentia is only available on Windows\n";
+
+        return 2;
+    }
+   #else
+    juce::File toolsDir = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory).getChildFile("AudioAnalyzer").getChildFile("Tools");
+
+    if (useEssentia && !(toolsDir.getChildFile("essentia_bpm.exe").existsAsFile() && toolsDir.getChildFile("essentia_key.exe").existsAsFile()))
+    {
+        std::cerr << "--essentia needs the Essentia tools in " << toolsDir.getFullPathName() << "; run the plugin with them once first\n";
+
+        return 2;
+    }
+   #endif
+
+    if (format != "json" && format != "csv")
+    {
+        std::cerr << "Unknown format: " << format << "\n";
+
+        return 2;
+    }
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    juce::String wildcard = formatManager.getWildcardForAllFormats();
+    juce::Array<juce::File> files;
+
+    if (manifestPath.isNotEmpty())
+    {
+        juce::File manifest = juce::File::getCurrentWorkingDirectory().getChildFile(manifestPath);
+        juce::StringArray lines;
+        lines.addLines(manifest.loadFileAsString());
+
+        for (auto& line : lines)
+        {
+            line = line.trim();
+
+            if (line.isEmpty() || line.startsWith("#")) continue;
+
+            // Relative entries are relative to the manifest, so it can be moved together with the files
+            addInput(manifest.getParentDirectory().getChildFile(line), wildcard, files);
+        }
+    }
+
+    for (auto& arg : args.arguments)
+    {
+        if (arg.isOption()) continue;
+
+        addInput(arg.resolveAsFile(), wildcard, files);
+    }
+
+    if (files.isEmpty())
+    {
+        std::cerr << "No audio files to analyze\n";
+
+        return 2;
+    }
+
+    std::unique_ptr<juce::FileOutputStream> fileOutput;
+
+    if (outputPath.isNotEmpty())
+    {
+        juce::File outputFile = juce::File::getCurrentWorkingDirectory().getChildFile(outputPath);
+        outputFile.deleteFile();
+        fileOutput = std::make_unique<juce::FileOutputStream>(outputFile);
+
+        if (!fileOutput->openedOk())
+        {
+            std::cerr << "Cannot write to " << outputFile.getFullPathName() << "\n";
+
+            return 2;
+        }
+    }
+
+    std::mutex outputMutex;
+
+    auto writeRecord = [&](const juce::String& record)
+    {
+        std::lock_guard<std::mutex> lock(outputMutex);
+
+        if (fileOutput != nullptr)
+        {
+            fileOutput->writeText(record + "\n", false, false, nullptr);
+            fileOutput->flush();
+        }
+        else
+        {
+            std::cout << record << "\n" << std::flush;
+        }
+    };
+
+    if (format == "csv") writeRecord(AnalysisReport::getCsvHeader());
+
+    // Every runner takes the next file; the stages of all running files share one worker pool
+    std::atomic<int> nextFile { 0 };
+    std::atomic<int> numFailed { 0 };
+    std::vector<std::thread> runners;
+
+    for (int i = 0; i < juce::jlimit(1, files.size(), numJobs); ++i)
+    {
+        runners.emplace_back([&]
+        {
+            AnalysisEngine engine;
+
+            engine.useNativeBpm = !useEssentia;
+            engine.useNativeKey = !useEssentia;
+            engine.spectrumLoudestSectionOnly = loudestSectionOnly;
+
+            if (scratchPath.isNotEmpty()) engine.scratchDirectory = juce::File::getCurrentWorkingDirectory().getChildFile(scratchPath);
+
+            for (int index = nextFile++; index < files.size(); index = nextFile++)
+            {
+                const juce::File& file = files.getReference(index);
+                SpectrumData spectrum;
+
+                TrackAnalysisData data = engine.analyzeFile(file, includeSpectrum ? &spectrum : nullptr);
+                juce::String error = data.sampleRate > 0 ? juce::String() : juce::String("unreadable audio file");
+
+                if (error.isNotEmpty()) numFailed++;
+
+                if (format == "csv")
+                {
+                    writeRecord(AnalysisReport::toCsv(file, data, error));
+                }
+                else
+                {
+                    writeRecord(AnalysisReport::toJson(file, data, error, includeSpectrum ? &spectrum : nullptr));
+                }
+            }
+        });
+    }
+
+    for (auto& runner : runners)
+    {
+        runner.join();
+    }
+
+    std::cerr << "Analyzed " << files.size() << " files, " << numFailed.load() << " failed\n";
+
+    return numFailed > 0 ? 1 : 0;
+}
\ No newline at end of file
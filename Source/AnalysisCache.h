@@ -0,0 +1,258 @@
+#pragma once
+
+#include "TrackAnalysisData.h"
+#include <JuceHeader.h>
+#include <algorithm>
+#include <cstring>
+
+class AnalysisCache
+{
+public:
+
+    AnalysisCache(int settings, juce::int64 maxBytes = defaultMaxCacheBytes) : settingsVersion(settings), maxCacheBytes(maxBytes)
+    {
+        cacheDir = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory).getChildFile("AudioAnalyzer").getChildFile("Cache");
+    }
+
+    // Hashes the size and the whole content, so a copied or renamed file still hits and any same-length edit
+    // (a click repair, a gain change on one section) misses. Words are mixed 8 bytes at a time, which keeps
+    // the pass close to disk speed.
+    static juce::String computeContentHash(juce::File audioFile)
+    {
+        juce::FileInputStream input(audioFile);
+
+        if (!input.openedOk()) return {};
+
+        juce::int64 fileSize = input.getTotalLength();
+        juce::uint64 hash = 14695981039346656037ull;
+
+        auto mixWord = [&hash](juce::uint64 word)
+        {
+            hash ^= word;
+            hash *= 1099511628211ull;
+        };
+
+        mixWord((juce::uint64)fileSize);
+
+        std::vector<char> chunk((size_t)hashChunkSize);
+        int bytesRead = 0;
+
+        while ((bytesRead = input.read(chunk.data(), hashChunkSize)) > 0)
+        {
+            int numWords = bytesRead / (int)sizeof(juce::uint64);
+
+            for (int i = 0; i < numWords; ++i)
+            {
+                juce::uint64 word;
+                std::memcpy(&word, chunk.data() + i * sizeof(juce::uint64), sizeof(word));
+                mixWord(word);
+            }
+
+            for (int i = numWords * (int)sizeof(juce::uint64); i < bytesRead; ++i)
+            {
+                mixWord((juce::uint8)chunk[(size_t)i]);
+            }
+        }
+
+        return juce::String::toHexString((juce::int64)hash);
+    }
+
+    // The variant separates results of the same file under different analysis options
+    juce::String makeKey(juce::File audioFile, const juce::String& variant = {}) const
+    {
+        juce::String hash = computeContentHash(audioFile);
+
+        if (hash.isEmpty()) return {};
+
+        return hash + "_v" + juce::String(settingsVersion) + variant;
+    }
+
+    bool load(const juce::String& key, TrackAnalysisData& data, SpectrumData& spectrum)
+    {
+        if (key.isEmpty()) return false;
+
+        juce::File entry = getEntryFile(key);
+
+        if (!entry.existsAsFile()) return false;
+
+        juce::MemoryBlock block;
+
+        if (!entry.loadFileAsData(block)) return false;
+
+        juce::MemoryInputStream in(block, false);
+
+        if (in.readInt() != magicNumber || in.readInt() != formatVersion || in.readInt() != settingsVersion)
+        {
+            entry.deleteFile();
+
+            return false;
+        }
+
+        TrackAnalysisData d;
+        SpectrumData s;
+
+        d.durationInSeconds = in.readDouble();
+        d.sampleRate = in.readDouble();
+        d.bpm = in.readDouble();
+        d.bpmConfidence = in.readDouble();
+        d.musicalKey = in.readString();
+        d.keyConfidence = in.readDouble();
+        d.camelotKey = in.readString();
+        d.integratedLUFS = in.readDouble();
+        d.shortTermMaxLUFS = in.readDouble();
+        d.momentaryMaxLUFS = in.readDouble();
+        d.loudnessRange = in.readDouble();
+        d.averageDynamicsPLR = in.readDouble();
+        d.truePeakMax = in.readDouble();
+
+        s.sampleRate = in.readDouble();
+
+        for (auto* vec : { &s.avgMid, &s.avgSide, &s.avgStereo, &s.maxMid, &s.maxSide, &s.maxStereo })
+        {
+            int size = in.readInt();
+
+            if (size < 0 || (juce::int64)size * (juce::int64)sizeof(float) > in.getNumBytesRemaining())
+            {
+                entry.deleteFile();
+
+                return false;
+            }
+
+            vec->resize((size_t)size);
+            in.read(vec->data(), size * (int)sizeof(float));
+        }
+
+        int numColumns = in.readInt();
+
+        if (numColumns > 0)
+        {
+            auto spectrogram = std::make_shared<SpectrogramData>();
+            spectrogram->sampleRate = s.sampleRate;
+            spectrogram->hopSize = in.readInt();
+            spectrogram->numColumns = numColumns;
+
+            juce::int64 numBytes = (juce::int64)numColumns * SpectrogramData::numBands;
+
+            if (numBytes > in.getNumBytesRemaining())
+            {
+                entry.deleteFile();
+
+                return false;
+            }
+
+            spectrogram->levels.resize((size_t)numBytes);
+            in.read(spectrogram->levels.data(), (int)numBytes);
+
+            s.spectrogram = spectrogram;
+        }
+
+        // Touching the entry keeps it at the young end of the LRU order
+        entry.setLastModificationTime(juce::Time::getCurrentTime());
+
+        d.loadedFromCache = true;
+        data = d;
+        spectrum = s;
+
+        return true;
+    }
+
+    // The spectrogram is only written when asked for, so entries of runs that never show it stay small
+    bool store(const juce::String& key, const TrackAnalysisData& d, const SpectrumData& s, bool withSpectrogram = false)
+    {
+        if (key.isEmpty()) return false;
+
+        if (!cacheDir.exists()) cacheDir.createDirectory();
+
+        juce::MemoryOutputStream out;
+
+        out.writeInt(magicNumber);
+        out.writeInt(formatVersion);
+        out.writeInt(settingsVersion);
+        out.writeDouble(d.durationInSeconds);
+        out.writeDouble(d.sampleRate);
+        out.writeDouble(d.bpm);
+        out.writeDouble(d.bpmConfidence);
+        out.writeString(d.musicalKey);
+        out.writeDouble(d.keyConfidence);
+        out.writeString(d.camelotKey);
+        out.writeDouble(d.integratedLUFS);
+        out.writeDouble(d.shortTermMaxLUFS);
+        out.writeDouble(d.momentaryMaxLUFS);
+        out.writeDouble(d.loudnessRange);
+        out.writeDouble(d.averageDynamicsPLR);
+        out.writeDouble(d.truePeakMax);
+        out.writeDouble(s.sampleRate);
+
+        for (auto* vec : { &s.avgMid, &s.avgSide, &s.avgStereo, &s.maxMid, &s.maxSide, &s.maxStereo })
+        {
+            out.writeInt((int)vec->size());
+            out.write(vec->data(), vec->size() * sizeof(float));
+        }
+
+        // About 2.7 KB per second of audio; absent for quick-look spectra
+        if (withSpectrogram && s.spectrogram != nullptr && !s.spectrogram->isEmpty())
+        {
+            out.writeInt(s.spectrogram->numColumns);
+            out.writeInt(s.spectrogram->hopSize);
+            out.write(s.spectrogram->levels.data(), s.spectrogram->levels.size());
+        }
+        else
+        {
+            out.writeInt(0);
+        }
+
+        // Written through a temporary file so a concurrent reader never sees a half-written entry
+        juce::TemporaryFile temp(getEntryFile(key));
+
+        if (!temp.getFile().replaceWithData(out.getData(), out.getDataSize())) return false;
+
+        bool stored = temp.overwriteTargetFileWithTemporary();
+
+        evictIfNeeded();
+
+        return stored;
+    }
+
+    void evictIfNeeded()
+    {
+        auto entries = cacheDir.findChildFiles(juce::File::findFiles, false, "*" + juce::String(entryExtension));
+        juce::int64 totalBytes = 0;
+
+        for (auto& f : entries)
+        {
+            totalBytes += f.getSize();
+        }
+
+        if (totalBytes <= maxCacheBytes) return;
+
+        std::sort(entries.begin(), entries.end(), [](const juce::File& a, const juce::File& b)
+        {
+            return a.getLastModificationTime() < b.getLastModificationTime();
+        });
+
+        for (auto& f : entries)
+        {
+            if (totalBytes <= maxCacheBytes) break;
+
+            totalBytes -= f.getSize();
+            f.deleteFile();
+        }
+    }
+
+private:
+
+    static constexpr int magicNumber = 0x41414348; // "AACH"
+    static constexpr int formatVersion = 2;
+    static constexpr int hashChunkSize = 1 << 20;
+    static constexpr juce::int64 defaultMaxCacheBytes = 100 * 1024 * 1024;
+    static constexpr const char* entryExtension = ".aacache";
+
+    juce::File getEntryFile(const juce::String& key) const
+    {
+        return cacheDir.getChildFile(key + entryExtension);
+    }
+
+    int settingsVersion;
+    juce::int64 maxCacheBytes;
+    juce::File cacheDir;
+};
\ No newline at end of file
@@ -1,63 +1,105 @@
 #pragma once
 
 #include "AnalysisPrep.h"
+#include "AnalysisProgress.h"
+#include "AnalysisStages.h"
+#include "AnalysisThreadPool.h"
+#include "EssentiaWorker.h"
+#include "NativeBpmDetector.h"
+#include "NativeKeyDetector.h"
+#include "SharedAudioSource.h"
+#include "TrackAnalysisData.h"
 #include <JuceHeader.h>
 #include <cmath>
-#include <map>
+#include <functional>
 #include <future>
+#include <map>
 
-extern "C"
+class AnalysisEngine
 {
-    #include "libebur128/ebur128.h"
-}
+public:
+    AnalysisEngine() {}
 
-struct TrackAnalysisData
-{
-    // Duration
-    double durationInSeconds = 0.0;
-
-    // BPM
-    double bpm = 0.0;
-    double bpmConfidence = 0.0;
-
-    // Key & Camelot
-    juce::String musicalKey = "Unknown";
-    double keyConfidence = 0.0;
-    juce::String camelotKey = "Unknown";
-
-    // Loudness
-    double integratedLUFS = -100.0;
-    double shortTermMaxLUFS = -100.0;
-    double momentaryMaxLUFS = -100.0;
-    double loudnessRange = 0.0;
-    double averageDynamicsPLR = 0.0;
-    double truePeakMax = -100.0;
-
-    // Elapsed Time
-    double timeAudioLoading = 0.0;
-    double timeLoudnessAnalysis = 0.0;
-    double timeBpmPrep = 0.0;
-    double timeBpmEssentia = 0.0;
-    double timeKeyPrep = 0.0;
-    double timeKeyEssentia = 0.0;
-    double timeSpectrumCalc = 0.0;
-    double timeTotal = 0.0;
-    
-    juce::String getFormattedDuration()
-    {
-        if (durationInSeconds <= 0) return "00:00";
+    // Bump whenever a change alters analysis results, so cached entries from older builds are ignored
+    static constexpr int settingsVersion = 7;
+
+    // The in-process estimators are the default; the embedded Essentia tools remain available as a fallback
+    bool useNativeBpm = true;
+    bool useNativeKey = true;
+
+    // The spectrum covers the whole track by default; the loudest 20 s are enough for a quick look
+    bool spectrumLoudestSectionOnly = false;
+
+    // Off by default: a spectrogram takes about 10 MB per hour of audio, and only the editor's single-file view shows it
+    bool captureSpectrogram = false;
+
+    // Appended to cache keys, so spectra of the two ranges are never mixed up
+    juce::String getCacheVariant() const { return spectrumLoudestSectionOnly ? "_loudest" : ""; }
 
-        int minutes = (int)durationInSeconds / 60;
-        int seconds = (int)durationInSeconds % 60;
+    // The loudest-section spectrum never comes with a spectrogram
+    bool capturesSpectrogram() const { return captureSpectrogram && !spectrumLoudestSectionOnly; }
 
-        return juce::String::formatted("%02d:%02d", minutes, seconds);
+    // Parts of a result that can be shown on their own; each is reported as soon as the stage producing it finishes
+    enum ResultPart
+    {
+        loudnessPart = 1,
+        bpmPart = 2,
+        keyPart = 4,
+        spectrumPart = 8,
+        allParts = loudnessPart | bpmPart | keyPart | spectrumPart
+    };
+
+    // Called from pool workers, possibly concurrently; the data holds the fields of the reported part
+    using PartialResultCallback = std::function<void(ResultPart part, const TrackAnalysisData& data)>;
+
+    // Copies the fields that belong to one part; the duration travels with the loudness part
+    static void mergeResultPart(TrackAnalysisData& target, ResultPart part, const TrackAnalysisData& source)
+    {
+        if (part == loudnessPart)
+        {
+            target.durationInSeconds = source.durationInSeconds;
+            target.sampleRate = source.sampleRate;
+            target.integratedLUFS = source.integratedLUFS;
+            target.loudnessRange = source.loudnessRange;
+            target.truePeakMax = source.truePeakMax;
+            target.averageDynamicsPLR = source.averageDynamicsPLR;
+            target.shortTermMaxLUFS = source.shortTermMaxLUFS;
+            target.momentaryMaxLUFS = source.momentaryMaxLUFS;
+            target.timeLoudnessAnalysis = source.timeLoudnessAnalysis;
+        }
+        else if (part == bpmPart)
+        {
+            target.bpm = source.bpm;
+            target.bpmConfidence = source.bpmConfidence;
+            target.timeBpmPrep = source.timeBpmPrep;
+            target.timeBpmEssentia = source.timeBpmEssentia;
+        }
+        else if (part == keyPart)
+        {
+            target.musicalKey = source.musicalKey;
+            target.camelotKey = source.camelotKey;
+            target.keyConfidence = source.keyConfidence;
+            target.timeKeyPrep = source.timeKeyPrep;
+            target.timeKeyEssentia = source.timeKeyEssentia;
+        }
+        else if (part == spectrumPart)
+        {
+            target.timeSpectrumCalc = source.timeSpectrumCalc;
+        }
     }
-};
 
-class AnalysisEngine
-{
-public:
-    AnalysisEngine() {}
+    // Where the fallback path writes its intermediate files; empty or unwritable means the system temp folder
+    juce::File scratchDirectory;
+
+    juce::File getScratchDirectory() const
+    {
+        if (scratchDirectory.isDirectory() && scratchDirectory.hasWriteAccess()) return scratchDirectory;
+
+        juce::File fallback = juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("AudioAnalyzer");
+        fallback.createDirectory();
+
+        return fallback;
+    }
 
     juce::String getCamelot(juce::String key, juce::String scale)
     {
@@ -145,153 +187,75 @@ public:
         return juce::var(obj);
     }
 
-    juce::var runEssentiaProcess(juce::File exeFile, juce::File audioFile, juce::File outputFile, bool hasOutputFileArg)
+    juce::var runEssentiaProcess(juce::File exeFile, juce::File audioFile, juce::File outputFile, bool hasOutputFileArg, AnalysisProgress* progress = nullptr)
     {
         if (!exeFile.existsAsFile()) return juce::var();
 
-        if (outputFile.exists()) outputFile.deleteFile();
-
-        juce::String command;
+        auto cancelFlag = progress != nullptr ? progress->getCancelFlag() : nullptr;
+        auto pendingOutput = essentiaWorker.submit({ exeFile, audioFile, outputFile, hasOutputFileArg, cancelFlag });
 
-        if (hasOutputFileArg)
+        // On cancellation the tool worker kills the tool within a few milliseconds, or skips the job if it is
+        // still queued; the result is awaited either way so the caller never deletes files a tool still reads
+        pool->waitUntil([&pendingOutput]
         {
-            // Essentia Key Arguments: "input" "output"
-            command = "\"" + exeFile.getFullPathName() + "\" \"" + audioFile.getFullPathName() + "\" \"" + outputFile.getFullPathName() + "\"";
-        }
-        else
-        {
-            // Essentia BPM Arguments: "input" (no output file, prints to stdout)
-            command = "\"" + exeFile.getFullPathName() + "\" \"" + audioFile.getFullPathName() + "\"";
-        }
+            return pendingOutput.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        });
 
-        juce::ChildProcess process;
+        if (cancelFlag != nullptr && cancelFlag->load()) return juce::var();
 
-        if (process.start(command))
-        {
-            juce::String outputStr = process.readAllProcessOutput();
-            process.waitForProcessToFinish(20000);
+        juce::String output = pendingOutput.get();
 
-            // Read stdout for BPM values
-            if (!hasOutputFileArg && outputStr.isNotEmpty())
-            {
-                /*outputFile.create();
-                outputFile.replaceWithText(outputStr);*/ // Optional Log File
+        if (output.isEmpty()) return juce::var();
 
-                return parseEssentiaOutput(outputStr, hasOutputFileArg);
-            }
+        return parseEssentiaOutput(output, hasOutputFileArg);
+    }
 
-            // Read JSON for Key values
-            if (hasOutputFileArg && outputFile.existsAsFile())
-            {
-                juce::String fileContent = outputFile.loadFileAsString();
+    // Folds a tempo into the 70-190 BPM range and rounds it
+    static double foldBpm(double bpm)
+    {
+        while (bpm < 70.0 && bpm > 0.0)
+        {
+            bpm *= 2.0;
+        }
 
-                return parseEssentiaOutput(fileContent, hasOutputFileArg);
-            }
+        while (bpm > 190.0)
+        {
+            bpm /= 2.0;
         }
 
-        return juce::var();
+        return std::round(bpm);
     }
 
-    bool extractToolIfNeeded(juce::File targetFile, const char* resourceData, int resourceSize)
+    // Fills the key fields from a tonic, a scale and a 0-1 strength, as reported by either estimator
+    void setKeyResult(TrackAnalysisData& d, juce::String key, juce::String scale, double strength)
     {
-        if (targetFile.existsAsFile() && targetFile.getSize() == resourceSize) return true;
+        if (key.isEmpty()) return;
 
-        targetFile.getParentDirectory().createDirectory();
+        key = key.substring(0, 1).toUpperCase() + key.substring(1);
 
-        if (targetFile.exists()) targetFile.deleteFile();
+        if (scale.isNotEmpty()) scale = scale.substring(0, 1).toUpperCase() + scale.substring(1).toLowerCase();
 
-        return targetFile.replaceWithData(resourceData, resourceSize);
+        d.musicalKey = key + " " + scale;
+        d.camelotKey = getCamelot(key, scale);
+        d.keyConfidence = std::sqrt(strength) * 100.0;
+        d.keyConfidence = juce::jlimit(0.0, 100.0, d.keyConfidence);
     }
 
-    TrackAnalysisData analyzeLoudnessWithLib(juce::File audioFile)
+    bool extractToolIfNeeded(juce::File targetFile, const char* resourceData, int resourceSize)
     {
-        TrackAnalysisData d;
-
-        double tStart = juce::Time::getMillisecondCounterHiRes();
-
-        juce::AudioFormatManager formatManager;
-        formatManager.registerBasicFormats();
-        std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(audioFile));
-
-        if (reader == nullptr) return d;
-
-        ebur128_state* st = ebur128_init((unsigned)reader->numChannels, (unsigned)reader->sampleRate, EBUR128_MODE_I | EBUR128_MODE_LRA | EBUR128_MODE_TRUE_PEAK | EBUR128_MODE_S | EBUR128_MODE_M);
-
-        if (!st) return d;
-
-        const int bufferSize = 4096;
-        juce::AudioBuffer<float> buffer(reader->numChannels, bufferSize);
-        std::vector<float> interleavedBuffer(bufferSize * reader->numChannels);
-
-        double maxMomentary = -1000.0;
-        double maxShortTerm = -1000.0;
-
-        int64_t position = 0;
-
-        while (position < reader->lengthInSamples)
-        {
-            int numSamples = (int)std::min((int64_t)bufferSize, reader->lengthInSamples - position);
-            reader->read(&buffer, 0, numSamples, position, true, true);
-
-            for (int i = 0; i < numSamples; ++i)
-            {
-                for (int ch = 0; ch < reader->numChannels; ++ch)
-                {
-                    interleavedBuffer[i * reader->numChannels + ch] = buffer.getSample(ch, i);
-                }
-            }
-
-            ebur128_add_frames_float(st, interleavedBuffer.data(), (size_t)numSamples);
-
-            double currentMom = -1000.0;
-            double currentST = -1000.0;
-
-            if (ebur128_loudness_momentary(st, &currentMom) == EBUR128_SUCCESS)
-            {
-                if (currentMom > maxMomentary) maxMomentary = currentMom;
-            }
-
-            if (ebur128_loudness_shortterm(st, &currentST) == EBUR128_SUCCESS)
-            {
-                if (currentST > maxShortTerm) maxShortTerm = currentST;
-            }
-
-            position += numSamples;
-        }
-
-        double val = -100.0;
-
-        if (ebur128_loudness_global(st, &val) == EBUR128_SUCCESS) d.integratedLUFS = val;
-
-        if (ebur128_loudness_range(st, &val) == EBUR128_SUCCESS) d.loudnessRange = val;
-
-        if (maxMomentary > -900.0) d.momentaryMaxLUFS = maxMomentary;
-
-        if (maxShortTerm > -900.0) d.shortTermMaxLUFS = maxShortTerm;
-
-        double maxPeak = 0.0;
-
-        for (int i = 0; i < reader->numChannels; ++i)
-        {
-            double chPeak = 0.0;
-
-            ebur128_true_peak(st, i, &chPeak);
-            
-            if (chPeak > maxPeak) maxPeak = chPeak;
-        }
-
-        if (maxPeak > 0.000001) d.truePeakMax = 20.0 * std::log10(maxPeak);
-
-        if (d.integratedLUFS > -100.0 && d.truePeakMax > -100.0) d.averageDynamicsPLR = d.truePeakMax - d.integratedLUFS;
+        if (targetFile.existsAsFile() && targetFile.getSize() == resourceSize) return true;
 
-        ebur128_destroy(&st);
+        targetFile.getParentDirectory().createDirectory();
 
-        d.timeLoudnessAnalysis = juce::Time::getMillisecondCounterHiRes() - tStart;
+        if (targetFile.exists()) targetFile.deleteFile();
 
-        return d;
+        return targetFile.replaceWithData(resourceData, resourceSize);
     }
 
-    TrackAnalysisData analyzeFile(juce::File audioFile)
+    // A cancelled analysis returns as soon as its current block or tool run is stopped, with empty data.
+    // The spectrum is filled as soon as decoding ends, before its part is reported.
+    TrackAnalysisData analyzeFile(juce::File audioFile, SpectrumData* spectrum = nullptr, AnalysisProgress* progress = nullptr,
+                                  PartialResultCallback onPartialResult = nullptr)
     {
         TrackAnalysisData finalData;
 
@@ -302,60 +266,90 @@ public:
         juce::File exeBPM = toolsDir.getChildFile("essentia_bpm.exe");
         juce::File exeKey = toolsDir.getChildFile("essentia_key.exe");
 
-        extractToolIfNeeded(exeBPM, BinaryData::essentia_streaming_rhythmextractor_multifeature_exe, BinaryData::essentia_streaming_rhythmextractor_multifeature_exeSize);
-        extractToolIfNeeded(exeKey, BinaryData::essentia_streaming_key_exe, BinaryData::essentia_streaming_key_exeSize);
+        // The plugin embeds the Windows-only Essentia tools as BinaryData; targets built without them use the
+        // tools a plugin has already extracted
+       #ifndef AUDIOANALYZER_EMBEDDED_ESSENTIA
+        #define AUDIOANALYZER_EMBEDDED_ESSENTIA 1
+       #endif
 
-        double tLoadStart = juce::Time::getMillisecondCounterHiRes();
+       #if AUDIOANALYZER_EMBEDDED_ESSENTIA
+        if (!useNativeBpm) extractToolIfNeeded(exeBPM, BinaryData::essentia_streaming_rhythmextractor_multifeature_exe, BinaryData::essentia_streaming_rhythmextractor_multifeature_exeSize);
+        if (!useNativeKey) extractToolIfNeeded(exeKey, BinaryData::essentia_streaming_key_exe, BinaryData::essentia_streaming_key_exeSize);
+       #endif
 
-        juce::AudioFormatManager formatManager;
-        formatManager.registerBasicFormats();
-        std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(audioFile));
+        SharedAudioSource source;
 
-        if (reader == nullptr) return finalData;
+        if (!source.open(audioFile)) return finalData;
 
-        double sampleRate = reader->sampleRate;
+        double sampleRate = source.getSampleRate();
 
-        finalData.durationInSeconds = reader->lengthInSamples / sampleRate;
+        finalData.sampleRate = sampleRate;
+        finalData.durationInSeconds = source.getLengthInSamples() / sampleRate;
 
-        finalData.timeAudioLoading = juce::Time::getMillisecondCounterHiRes() - tLoadStart;
+        // Single decode pass feeding loudness, BPM prep, key prep and spectrum at once
+        LoudnessStage loudnessStage;
+        PrepStage bpmStage(PrepStage::Target::bpm);
+        PrepStage keyStage(PrepStage::Target::key);
+        SpectrumStage spectrumStage(spectrumLoudestSectionOnly ? SpectrumStage::Range::loudestSection : SpectrumStage::Range::fullTrack, captureSpectrogram);
 
-        juce::String uniqueId = juce::String::toHexString(juce::Random::getSystemRandom().nextInt64());
+        loudnessStage.progressStage = AnalysisProgress::loudness;
+        bpmStage.progressStage = AnalysisProgress::bpmPrep;
+        keyStage.progressStage = AnalysisProgress::keyPrep;
 
-        // Loudness Analysis
-        auto futureLoudness = std::async(std::launch::async, [this, audioFile]() -> TrackAnalysisData
+        auto isCancelled = [progress] { return progress != nullptr && progress->isCancelled(); };
+        auto setProgress = [progress](AnalysisProgress::Stage stage, float fraction)
         {
-            return analyzeLoudnessWithLib(audioFile);
-        });
+            if (progress != nullptr) progress->setStageProgress(stage, fraction);
+        };
+
+        auto report = [&onPartialResult](ResultPart part, const TrackAnalysisData& data)
+        {
+            if (onPartialResult) onPartialResult(part, data);
+        };
+
+        std::vector<AudioBlockConsumer*> consumers { &loudnessStage, &bpmStage, &keyStage };
+
+        if (spectrum != nullptr) consumers.push_back(&spectrumStage);
+
+        // The native estimators read the prepared buffers in memory; only the Essentia fallback needs files,
+        // and those go to the scratch folder rather than next to the source (often a NAS or read-only library)
+        juce::String uniqueId = juce::String::toHexString(juce::Random::getSystemRandom().nextInt64());
+        juce::File scratchDir = (useNativeBpm && useNativeKey) ? juce::File() : getScratchDirectory();
 
         // BPM Analysis
-        auto futureBPM = std::async(std::launch::async, [this, audioFile, exeBPM, sampleRate, uniqueId]() -> TrackAnalysisData
+        auto analyzeBpm = [this, scratchDir, exeBPM, uniqueId, progress, &bpmStage]() -> TrackAnalysisData
         {
             TrackAnalysisData d;
 
-            juce::AudioFormatManager fm; fm.registerBasicFormats();
-            std::unique_ptr<juce::AudioFormatReader> r(fm.createReaderFor(audioFile));
-            juce::AudioBuffer<float> bpmBuffer(r->numChannels, (int)r->lengthInSamples);
-            r->read(&bpmBuffer, 0, (int)r->lengthInSamples, 0, true, true);
+            if (useNativeBpm)
+            {
+                d.timeBpmPrep = bpmStage.processingTime;
+
+                double tStart = juce::Time::getMillisecondCounterHiRes();
+
+                auto estimate = NativeBpmDetector::estimate(bpmStage.buffer, bpmStage.sampleRate);
+
+                d.timeBpmEssentia = juce::Time::getMillisecondCounterHiRes() - tStart;
+                d.bpm = foldBpm(estimate.bpm);
+                d.bpmConfidence = estimate.confidence;
 
-            AnalysisPrep::normalizeAudio(bpmBuffer, -6.0f);
+                return d;
+            }
 
             double tStart = juce::Time::getMillisecondCounterHiRes();
-                
-            AnalysisPrep::applyBpmFilter(bpmBuffer, sampleRate);
-            AnalysisPrep::cropToLoudestSection(bpmBuffer, sampleRate, 30.0);
 
-            juce::File tempWav = audioFile.getParentDirectory().getChildFile("temp_bpm_" + uniqueId + ".wav");
-            bool saved = AnalysisPrep::saveTempWav(bpmBuffer, sampleRate, tempWav);
+            juce::File tempWav = scratchDir.getChildFile("temp_bpm_" + uniqueId + ".wav");
+            bool saved = AnalysisPrep::saveTempWav(bpmStage.buffer, bpmStage.sampleRate, tempWav);
             
-            d.timeBpmPrep = juce::Time::getMillisecondCounterHiRes() - tStart;
+            d.timeBpmPrep = bpmStage.processingTime + juce::Time::getMillisecondCounterHiRes() - tStart;
 
             if (saved)
             {
                 tStart = juce::Time::getMillisecondCounterHiRes();
 
-                juce::File outLog = audioFile.getParentDirectory().getChildFile("temp_bpm_out_" + uniqueId + ".txt");
+                juce::File outLog = scratchDir.getChildFile("temp_bpm_out_" + uniqueId + ".txt");
 
-                auto json = runEssentiaProcess(exeBPM, tempWav, outLog, false);
+                auto json = runEssentiaProcess(exeBPM, tempWav, outLog, false, progress);
 
                 d.timeBpmEssentia = juce::Time::getMillisecondCounterHiRes() - tStart;
 
@@ -371,18 +365,7 @@ public:
                     rawConf /= 5;
                     d.bpmConfidence = std::sqrt(rawConf) * 100.0;
                     d.bpmConfidence = juce::jlimit(0.0, 100.0, d.bpmConfidence);
-
-                    while (d.bpm < 70.0 && d.bpm > 0.0)
-                    {
-                        d.bpm *= 2.0;
-                    }
-
-                    while (d.bpm > 190.0)
-                    {
-                        d.bpm /= 2.0;
-                    }
-
-                    d.bpm = std::round(d.bpm);
+                    d.bpm = foldBpm(d.bpm);
                 }
 
                 tempWav.deleteFile();
@@ -391,38 +374,41 @@ public:
             }
             
             return d;
-        });
+        };
 
         // Key Analysis
-        auto futureKey = std::async(std::launch::async, [this, audioFile, exeKey, sampleRate, uniqueId]() -> TrackAnalysisData
+        auto analyzeKey = [this, scratchDir, exeKey, uniqueId, progress, &keyStage]() -> TrackAnalysisData
         {
             TrackAnalysisData d;
-            juce::AudioBuffer<float> keyBuffer;
-            
-            juce::AudioFormatManager fm; fm.registerBasicFormats();
-            std::unique_ptr<juce::AudioFormatReader> r(fm.createReaderFor(audioFile));
-            keyBuffer.setSize(r->numChannels, (int)r->lengthInSamples);
-            r->read(&keyBuffer, 0, (int)r->lengthInSamples, 0, true, true);
 
-            AnalysisPrep::normalizeAudio(keyBuffer, -6.0f);
+            if (useNativeKey)
+            {
+                d.timeKeyPrep = keyStage.processingTime;
+
+                double tStart = juce::Time::getMillisecondCounterHiRes();
+
+                auto estimate = NativeKeyDetector::estimate(keyStage.buffer, keyStage.sampleRate);
+
+                d.timeKeyEssentia = juce::Time::getMillisecondCounterHiRes() - tStart;
+                setKeyResult(d, estimate.key, estimate.scale, estimate.strength);
+
+                return d;
+            }
 
             double tStart = juce::Time::getMillisecondCounterHiRes();
-            
-            AnalysisPrep::applyKeyFilter(keyBuffer, sampleRate);
-            AnalysisPrep::cropToLoudestSection(keyBuffer, sampleRate, 60.0);
 
-            juce::File tempWav = audioFile.getParentDirectory().getChildFile("temp_key_" + uniqueId + ".wav");
-            bool saved = AnalysisPrep::saveTempWav(keyBuffer, sampleRate, tempWav);
+            juce::File tempWav = scratchDir.getChildFile("temp_key_" + uniqueId + ".wav");
+            bool saved = AnalysisPrep::saveTempWav(keyStage.buffer, keyStage.sampleRate, tempWav);
                 
-            d.timeKeyPrep = juce::Time::getMillisecondCounterHiRes() - tStart;
+            d.timeKeyPrep = keyStage.processingTime + juce::Time::getMillisecondCounterHiRes() - tStart;
 
             if (saved)
             {
                 tStart = juce::Time::getMillisecondCounterHiRes();
 
-                juce::File outLog = audioFile.getParentDirectory().getChildFile("temp_key_out_" + uniqueId + ".json");
+                juce::File outLog = scratchDir.getChildFile("temp_key_out_" + uniqueId + ".json");
 
-                auto json = runEssentiaProcess(exeKey, tempWav, outLog, true);
+                auto json = runEssentiaProcess(exeKey, tempWav, outLog, true, progress);
 
                 d.timeKeyEssentia = juce::Time::getMillisecondCounterHiRes() - tStart;
 
@@ -454,17 +440,7 @@ public:
                         else if (json.hasProperty("strength")) strength = (double)json["strength"];
                     }
 
-                    if (key.isNotEmpty())
-                    {
-                        key = key.substring(0, 1).toUpperCase() + key.substring(1);
-
-                        if (scale.isNotEmpty()) scale = scale.substring(0, 1).toUpperCase() + scale.substring(1).toLowerCase();
-
-                        d.musicalKey = key + " " + scale;
-                        d.camelotKey = getCamelot(key, scale);
-                        d.keyConfidence = std::sqrt(strength) * 100.0;
-                        d.keyConfidence = juce::jlimit(0.0, 100.0, d.keyConfidence);
-                    }
+                    setKeyResult(d, key, scale, strength);
                 }
 
                 tempWav.deleteFile();
@@ -473,31 +449,86 @@ public:
             }
 
             return d;
+        };
+
+        TrackAnalysisData bpmResult, keyResult;
+
+        // Decode with the streaming stages first, then BPM and key estimation side by side, then the merge
+        AnalysisTaskGraph graph(*pool);
+
+        auto decodeNode = graph.add([&]
+        {
+            finalData.timeAudioLoading = source.run(consumers, progress);
+            finalData.usedMemoryMappedReader = source.isMemoryMapped();
+            finalData.timeMemoryMapping = source.getMappingTime();
+            finalData.bytesReadFromMapping = source.getBytesReadFromMapping();
+            finalData.reusedBlockBytes = source.getReusedBlockBytes();
+
+            if (isCancelled()) return;
+
+            // Loudness and the spectrum are final once decoding ends, well before BPM and key
+            auto& loudness = loudnessStage.result;
+            loudness.durationInSeconds = finalData.durationInSeconds;
+            loudness.sampleRate = finalData.sampleRate;
+            loudness.timeLoudnessAnalysis = loudnessStage.processingTime;
+
+            report(loudnessPart, loudness);
+
+            if (spectrum != nullptr)
+            {
+                *spectrum = std::move(spectrumStage.result);
+
+                TrackAnalysisData spectrumTiming;
+                spectrumTiming.timeSpectrumCalc = spectrumStage.processingTime;
+
+                report(spectrumPart, spectrumTiming);
+            }
         });
 
-        auto r1 = futureLoudness.get();
-        auto r2 = futureBPM.get();
-        auto r3 = futureKey.get();
-
-        finalData.bpm = r2.bpm;
-        finalData.bpmConfidence = r2.bpmConfidence;
-        finalData.timeBpmPrep = r2.timeBpmPrep;
-        finalData.timeBpmEssentia = r2.timeBpmEssentia;
-        finalData.musicalKey = r3.musicalKey;
-        finalData.camelotKey = r3.camelotKey;
-        finalData.keyConfidence = r3.keyConfidence;
-        finalData.timeKeyPrep = r3.timeKeyPrep;
-        finalData.timeKeyEssentia = r3.timeKeyEssentia;
-        finalData.integratedLUFS = r1.integratedLUFS;
-        finalData.loudnessRange = r1.loudnessRange;
-        finalData.truePeakMax = r1.truePeakMax;
-        finalData.averageDynamicsPLR = r1.averageDynamicsPLR;
-        finalData.shortTermMaxLUFS = r1.shortTermMaxLUFS;
-        finalData.momentaryMaxLUFS = r1.momentaryMaxLUFS;
-        finalData.timeLoudnessAnalysis = r1.timeLoudnessAnalysis;
-        
+        auto bpmNode = graph.add([&]
+        {
+            if (isCancelled()) return;
+
+            bpmResult = analyzeBpm();
+            setProgress(AnalysisProgress::bpmDetection, 1.0f);
+
+            if (!isCancelled()) report(bpmPart, bpmResult);
+        }, { decodeNode });
+
+        auto keyNode = graph.add([&]
+        {
+            if (isCancelled()) return;
+
+            keyResult = analyzeKey();
+            setProgress(AnalysisProgress::keyDetection, 1.0f);
+
+            if (!isCancelled()) report(keyPart, keyResult);
+        }, { decodeNode });
+
+        graph.add([&]
+        {
+            if (isCancelled()) return;
+
+            mergeResultPart(finalData, loudnessPart, loudnessStage.result);
+            mergeResultPart(finalData, bpmPart, bpmResult);
+            mergeResultPart(finalData, keyPart, keyResult);
+
+            finalData.timeSpectrumCalc = spectrumStage.processingTime;
+        }, { bpmNode, keyNode });
+
+        graph.run(isCancelled);
+
+        if (isCancelled()) return {};
+
         finalData.timeTotal = juce::Time::getMillisecondCounterHiRes() - tGlobalStart;
 
         return finalData;
     }
+
+private:
+
+    juce::SharedResourcePointer<AnalysisThreadPool> pool;
+
+    // Outlives individual analyses, so batch runs on the fallback path reuse the same worker threads
+    EssentiaWorker essentiaWorker;
 };
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <algorithm>
+#include <deque>
 
 class AnalysisPrep
 {
@@ -56,127 +58,462 @@ public:
 
     static void applyBpmFilter(juce::AudioBuffer<float>& buffer, double sampleRate)
     {
-        juce::AudioBuffer<float> lowBandBuffer;
-        lowBandBuffer.makeCopyOf(buffer);
-        juce::AudioBuffer<float> highBandBuffer;
-        highBandBuffer.makeCopyOf(buffer);
+        BpmFilter filter;
+        filter.prepare(buffer.getNumChannels(), sampleRate);
 
+        for (int start = 0; start < buffer.getNumSamples(); start += streamBlockSize)
         {
-            juce::dsp::AudioBlock<float> block(lowBandBuffer);
-            juce::dsp::ProcessContextReplacing<float> context(block);
+            filter.process(buffer, start, std::min(streamBlockSize, buffer.getNumSamples() - start));
+        }
+    }
+
+    static void applyKeyFilter(juce::AudioBuffer<float>& buffer, double sampleRate)
+    {
+        KeyFilter filter;
+        filter.prepare(buffer.getNumChannels(), sampleRate);
+
+        for (int start = 0; start < buffer.getNumSamples(); start += streamBlockSize)
+        {
+            filter.process(buffer, start, std::min(streamBlockSize, buffer.getNumSamples() - start));
+        }
+    }
+
+    static bool saveTempWav(juce::AudioBuffer<float>& buffer, double sampleRate, juce::File targetFile)
+    {
+        targetFile.deleteFile();
+
+        juce::WavAudioFormat wavFormat;
+        std::unique_ptr<juce::FileOutputStream> fileStream(targetFile.createOutputStream());
+
+        if (fileStream == nullptr) return false;
+
+        std::unique_ptr<juce::AudioFormatWriter> writer(wavFormat.createWriterFor(fileStream.get(), sampleRate, 1, 16, {}, 0));
+
+        if (writer == nullptr) return false;
 
-            auto coeffsHP = juce::dsp::IIR::Coefficients<float>::makeHighPass(sampleRate, 40.0f);
-            auto coeffsLP = juce::dsp::IIR::Coefficients<float>::makeLowPass(sampleRate, 1000.0f);
+        fileStream.release();
 
-            for (int ch = 0; ch < lowBandBuffer.getNumChannels(); ++ch)
-            {    
-                juce::dsp::IIR::Filter<float> filterHP;
-                filterHP.coefficients = coeffsHP;
-                filterHP.prepare({ sampleRate, (juce::uint32)block.getNumSamples(), 1 });
+        // Downmix block by block so no full-length mono copy is needed
+        juce::AudioBuffer<float> monoBlock(1, streamBlockSize);
+        int numChannels = buffer.getNumChannels();
+
+        for (int start = 0; start < buffer.getNumSamples(); start += streamBlockSize)
+        {
+            int numSamples = std::min(streamBlockSize, buffer.getNumSamples() - start);
 
-                auto singleBlock = block.getSingleChannelBlock(ch);
-                juce::dsp::ProcessContextReplacing<float> singleContext(singleBlock);
-                filterHP.process(singleContext);
+            monoBlock.copyFrom(0, 0, buffer, 0, start, numSamples);
 
-                juce::dsp::IIR::Filter<float> filterLP;
-                filterLP.coefficients = coeffsLP;
-                filterLP.prepare({ sampleRate, (juce::uint32)block.getNumSamples(), 1 });
-                filterLP.process(singleContext);
+            for (int ch = 1; ch < numChannels; ++ch)
+            {
+                monoBlock.addFrom(0, 0, buffer, ch, start, numSamples);
             }
+
+            if (numChannels > 1) monoBlock.applyGain(0, 0, numSamples, 1.0f / numChannels);
+
+            if (!writer->writeFromAudioSampleBuffer(monoBlock, 0, numSamples)) return false;
         }
 
+        return true;
+    }
+
+    static constexpr int streamBlockSize = 8192;
+
+    // Lowest output rates for the prep branches: the BPM high band needs content above 8 kHz, and key work runs
+    // up to 5 kHz. The decimator's -6 dB point is 0.8 of the output Nyquist and its flat passband ends near
+    // 0.31 of the output rate, so a 16 kHz floor keeps the key band flat to about 5 kHz
+    static constexpr double bpmAnalysisRate = 32000.0;
+    static constexpr double keyAnalysisRate = 16000.0;
+
+    // Anti-aliased integer-factor decimator that keeps its state between blocks. The factor is the largest
+    // that keeps the output at or above the target rate; only every factor-th output of the windowed-sinc
+    // low-pass is computed, which is what makes the polyphase form cheap.
+    class Decimator
+    {
+    public:
+
+        void prepare(int numChannels, double inputRate, double targetRate)
         {
-            juce::dsp::AudioBlock<float> block(highBandBuffer);
+            factor = juce::jmax(1, (int)std::floor(inputRate / targetRate));
+            outputRate = inputRate / factor;
+            nextOffset = 0;
+
+            int numTaps = factor * tapsPerPhase;
+            double cutoff = passbandFraction * 0.5 / factor;
+            double centre = (numTaps - 1) * 0.5;
+            double sum = 0.0;
 
-            auto coeffsHP = juce::dsp::IIR::Coefficients<float>::makeHighPass(sampleRate, 8000.0f);
+            coefficients.resize((size_t)numTaps);
 
-            for (int ch = 0; ch < highBandBuffer.getNumChannels(); ++ch)
+            for (int n = 0; n < numTaps; ++n)
             {
-                juce::dsp::IIR::Filter<float> filter;
-                filter.coefficients = coeffsHP;
-                filter.prepare({ sampleRate, (juce::uint32)block.getNumSamples(), 1 });
+                double x = n - centre;
+                double sinc = x == 0.0 ? 2.0 * cutoff : std::sin(juce::MathConstants<double>::twoPi * cutoff * x) / (juce::MathConstants<double>::pi * x);
+                double phase = juce::MathConstants<double>::twoPi * n / (numTaps - 1);
+                double blackman = 0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase);
 
-                auto singleBlock = block.getSingleChannelBlock(ch);
-                juce::dsp::ProcessContextReplacing<float> singleContext(singleBlock);
-                filter.process(singleContext);
+                coefficients[(size_t)n] = (float)(sinc * blackman);
+                sum += coefficients[(size_t)n];
             }
+
+            // Coefficients are stored reversed so each output is a straight dot product over the history
+            for (auto& c : coefficients)
+            {
+                c = (float)(c / sum);
+            }
+
+            std::reverse(coefficients.begin(), coefficients.end());
+
+            history.assign((size_t)numChannels, std::vector<float>((size_t)numTaps - 1, 0.0f));
         }
 
-        buffer.clear();
+        int getFactor() const { return factor; }
+        double getOutputRate() const { return outputRate; }
+
+        // Upper bound on the number of outputs produced from numInputSamples
+        int getMaxOutputSamples(int numInputSamples) const { return numInputSamples / factor + 1; }
 
-        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        // Decimates numSamples of input into output (resized as needed) and returns the number of samples written
+        int process(const juce::AudioBuffer<float>& input, int numSamples, juce::AudioBuffer<float>& output)
         {
-            buffer.addFrom(ch, 0, lowBandBuffer, ch, 0, buffer.getNumSamples());
-            buffer.addFrom(ch, 0, highBandBuffer, ch, 0, buffer.getNumSamples());
+            int numChannels = (int)history.size();
+
+            output.setSize(numChannels, getMaxOutputSamples(numSamples), false, false, true);
+
+            if (factor == 1)
+            {
+                for (int ch = 0; ch < numChannels; ++ch)
+                {
+                    output.copyFrom(ch, 0, input, ch, 0, numSamples);
+                }
+
+                return numSamples;
+            }
+
+            int numTaps = (int)coefficients.size();
+            int numOutputs = 0;
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                auto& state = history[(size_t)ch];
+
+                work.resize(state.size() + (size_t)numSamples);
+                std::copy(state.begin(), state.end(), work.begin());
+                std::copy(input.getReadPointer(ch), input.getReadPointer(ch) + numSamples, work.begin() + (std::ptrdiff_t)state.size());
+
+                auto* out = output.getWritePointer(ch);
+                numOutputs = 0;
+
+                for (int pos = nextOffset; pos < numSamples; pos += factor)
+                {
+                    const float* window = work.data() + pos;
+                    float acc = 0.0f;
+
+                    for (int k = 0; k < numTaps; ++k)
+                    {
+                        acc += coefficients[(size_t)k] * window[k];
+                    }
+
+                    out[numOutputs++] = acc;
+                }
+
+                std::copy(work.end() - (std::ptrdiff_t)state.size(), work.end(), state.begin());
+            }
+
+            int consumed = nextOffset + numOutputs * factor;
+            nextOffset = consumed - numSamples;
+
+            return numOutputs;
         }
 
-        buffer.applyGain(0.707f);
-    }
+    private:
 
-    static void applyKeyFilter(juce::AudioBuffer<float>& buffer, double sampleRate)
+        static constexpr int tapsPerPhase = 32;
+        static constexpr double passbandFraction = 0.8;
+
+        int factor = 1;
+        double outputRate = 0.0;
+        int nextOffset = 0;
+        std::vector<float> coefficients;
+        std::vector<std::vector<float>> history;
+        std::vector<float> work;
+    };
+
+    // Two-band BPM emphasis filter (40 Hz - 1 kHz plus everything above 8 kHz) that keeps its state between blocks
+    class BpmFilter
     {
-        juce::dsp::AudioBlock<float> block(buffer);
+    public:
 
-        auto coeffsHP = juce::dsp::IIR::Coefficients<float>::makeHighPass(sampleRate, 150.0f);
-        auto coeffsLP = juce::dsp::IIR::Coefficients<float>::makeLowPass(sampleRate, 5000.0f);
-        auto coeffsBoost = juce::dsp::IIR::Coefficients<float>::makeLowShelf(sampleRate, 300.0f, 1.0f, 2.0f);
+        void prepare(int numChannels, double sampleRate)
+        {
+            auto coeffsLowHP = juce::dsp::IIR::Coefficients<float>::makeHighPass(sampleRate, 40.0f);
+            auto coeffsLowLP = juce::dsp::IIR::Coefficients<float>::makeLowPass(sampleRate, 1000.0f);
+            auto coeffsHighHP = juce::dsp::IIR::Coefficients<float>::makeHighPass(sampleRate, 8000.0f);
+
+            lowHP.clear(); lowLP.clear(); highHP.clear();
+            lowHP.reserve((size_t)numChannels); lowLP.reserve((size_t)numChannels); highHP.reserve((size_t)numChannels);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                lowHP.emplace_back(coeffsLowHP);
+                lowLP.emplace_back(coeffsLowLP);
+                highHP.emplace_back(coeffsHighHP);
 
-        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+                lowHP.back().prepare({ sampleRate, (juce::uint32)streamBlockSize, 1 });
+                lowLP.back().prepare({ sampleRate, (juce::uint32)streamBlockSize, 1 });
+                highHP.back().prepare({ sampleRate, (juce::uint32)streamBlockSize, 1 });
+            }
+
+            highBand.setSize(1, streamBlockSize);
+        }
+
+        void process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
         {
-            auto singleChannelBlock = block.getSingleChannelBlock(ch);
-            juce::dsp::ProcessContextReplacing<float> context(singleChannelBlock);
+            juce::dsp::AudioBlock<float> block(buffer);
+            juce::dsp::AudioBlock<float> highBlock(highBand);
 
-            juce::dsp::IIR::Filter<float> filterBoost;
-            filterBoost.coefficients = coeffsBoost;
-            filterBoost.prepare({ sampleRate, (juce::uint32)block.getNumSamples(), 1 });
-            filterBoost.process(context);
+            for (int offset = 0; offset < numSamples; offset += streamBlockSize)
+            {
+                int n = std::min(streamBlockSize, numSamples - offset);
 
-            juce::dsp::IIR::Filter<float> filterHP;
-            filterHP.coefficients = coeffsHP;
-            filterHP.prepare({ sampleRate, (juce::uint32)block.getNumSamples(), 1 });
-            filterHP.process(context);
+                for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+                {
+                    highBand.copyFrom(0, 0, buffer, ch, startSample + offset, n);
 
-            juce::dsp::IIR::Filter<float> filterLP;
-            filterLP.coefficients = coeffsLP;
-            filterLP.prepare({ sampleRate, (juce::uint32)block.getNumSamples(), 1 });
-            filterLP.process(context);
+                    auto lowChannel = block.getSingleChannelBlock((size_t)ch).getSubBlock((size_t)(startSample + offset), (size_t)n);
+                    juce::dsp::ProcessContextReplacing<float> lowContext(lowChannel);
+                    lowHP[(size_t)ch].process(lowContext);
+                    lowLP[(size_t)ch].process(lowContext);
+
+                    auto highChannel = highBlock.getSubBlock(0, (size_t)n);
+                    juce::dsp::ProcessContextReplacing<float> highContext(highChannel);
+                    highHP[(size_t)ch].process(highContext);
+
+                    buffer.addFrom(ch, startSample + offset, highBand, 0, 0, n);
+                    buffer.applyGain(ch, startSample + offset, n, 0.707f);
+                }
+            }
         }
-    }
 
-    static bool saveTempWav(juce::AudioBuffer<float>& buffer, double sampleRate, juce::File targetFile)
+    private:
+
+        std::vector<juce::dsp::IIR::Filter<float>> lowHP, lowLP, highHP;
+        juce::AudioBuffer<float> highBand;
+    };
+
+    // Key emphasis filter (300 Hz shelf boost, 150 Hz - 5 kHz band) that keeps its state between blocks
+    class KeyFilter
     {
-        targetFile.deleteFile();
+    public:
+
+        void prepare(int numChannels, double sampleRate)
+        {
+            auto coeffsHP = juce::dsp::IIR::Coefficients<float>::makeHighPass(sampleRate, 150.0f);
+            auto coeffsLP = juce::dsp::IIR::Coefficients<float>::makeLowPass(sampleRate, 5000.0f);
+            auto coeffsBoost = juce::dsp::IIR::Coefficients<float>::makeLowShelf(sampleRate, 300.0f, 1.0f, 2.0f);
 
-        juce::AudioBuffer<float> monoBuffer;
+            filterBoost.clear(); filterHP.clear(); filterLP.clear();
+            filterBoost.reserve((size_t)numChannels); filterHP.reserve((size_t)numChannels); filterLP.reserve((size_t)numChannels);
 
-        if (buffer.getNumChannels() > 1)
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                filterBoost.emplace_back(coeffsBoost);
+                filterHP.emplace_back(coeffsHP);
+                filterLP.emplace_back(coeffsLP);
+
+                filterBoost.back().prepare({ sampleRate, (juce::uint32)streamBlockSize, 1 });
+                filterHP.back().prepare({ sampleRate, (juce::uint32)streamBlockSize, 1 });
+                filterLP.back().prepare({ sampleRate, (juce::uint32)streamBlockSize, 1 });
+            }
+        }
+
+        void process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
         {
-            monoBuffer.setSize(1, buffer.getNumSamples());
-            monoBuffer.clear();
+            juce::dsp::AudioBlock<float> block(buffer);
 
             for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
             {
-                monoBuffer.addFrom(0, 0, buffer, ch, 0, buffer.getNumSamples());
+                auto singleChannelBlock = block.getSingleChannelBlock((size_t)ch).getSubBlock((size_t)startSample, (size_t)numSamples);
+                juce::dsp::ProcessContextReplacing<float> context(singleChannelBlock);
+
+                filterBoost[(size_t)ch].process(context);
+                filterHP[(size_t)ch].process(context);
+                filterLP[(size_t)ch].process(context);
             }
-            
-            monoBuffer.applyGain(1.0f / buffer.getNumChannels());
         }
-        else monoBuffer.makeCopyOf(buffer);
 
-        juce::WavAudioFormat wavFormat;
-        std::unique_ptr<juce::FileOutputStream> fileStream(targetFile.createOutputStream());
+    private:
 
-        if (fileStream == nullptr) return false;
+        std::vector<juce::dsp::IIR::Filter<float>> filterBoost, filterHP, filterLP;
+    };
 
-        std::unique_ptr<juce::AudioFormatWriter> writer(wavFormat.createWriterFor(fileStream.get(), sampleRate, 1, 16, {}, 0));
+    // Streaming counterpart of cropToLoudestSection: keeps only a ring of (window + step) samples and
+    // copies a window out once it is known to be the loudest so far, so memory does not grow with track length
+    class LoudestSectionCollector
+    {
+    public:
 
-        if (writer != nullptr)
+        void prepare(int numChannels, double sampleRate, double durationSeconds, juce::int64 totalSamples)
         {
-            fileStream.release();
+            channels = numChannels;
+            total = totalSamples;
+            windowSamples = (int)(durationSeconds * sampleRate);
+            stepSize = juce::jmax(1, (int)(sampleRate * 0.5));
+            position = 0;
+            maxRMS = -1.0;
+            hasPending = false;
+
+            if (total <= windowSamples)
+            {
+                // Short track: everything is kept, as cropToLoudestSection would
+                windowSamples = (int)total;
+                result.setSize(numChannels, windowSamples);
+                result.clear();
+                ring.setSize(0, 0);
+
+                return;
+            }
 
-            return writer->writeFromAudioSampleBuffer(monoBuffer, 0, monoBuffer.getNumSamples());
+            ringSize = windowSamples + stepSize;
+            ring.setSize(numChannels, ringSize);
+            result.setSize(numChannels, windowSamples);
+            result.clear();
+
+            cumulativeEnergy.assign((size_t)numChannels, 0.0);
+            windowStartEnergy.clear();
+            nextWindowStart = 0;
         }
 
-        return false;
-    }
+        void push(const juce::AudioBuffer<float>& block, int numSamples)
+        {
+            if (ring.getNumSamples() == 0)
+            {
+                int toCopy = (int)std::min((juce::int64)numSamples, total - position);
+
+                for (int ch = 0; ch < channels; ++ch)
+                {
+                    if (toCopy > 0) result.copyFrom(ch, (int)position, block, ch, 0, toCopy);
+                }
+
+                position += numSamples;
+
+                return;
+            }
+
+            int offset = 0;
+
+            while (offset < numSamples)
+            {
+                // Snapshot the running energy at every candidate window start
+                if (position == nextWindowStart && nextWindowStart < total - windowSamples)
+                {
+                    windowStartEnergy.push_back(cumulativeEnergy);
+                    nextWindowStart += stepSize;
+                }
+
+                juce::int64 limit = numSamples - offset;
+
+                if (nextWindowStart < total - windowSamples) limit = std::min(limit, nextWindowStart - position);
+
+                if (!windowStartEnergy.empty()) limit = std::min(limit, nextWindowEnd() - position);
+
+                if (hasPending) limit = std::min(limit, pendingEnd + stepSize - position);
+
+                int n = (int)juce::jmax((juce::int64)1, limit);
+
+                writeToRing(block, offset, n);
+
+                offset += n;
+                position += n;
+
+                if (!windowStartEnergy.empty() && position == nextWindowEnd())
+                {
+                    double currentRMS = 0.0;
+
+                    for (int ch = 0; ch < channels; ++ch)
+                    {
+                        double energy = cumulativeEnergy[(size_t)ch] - windowStartEnergy.front()[(size_t)ch];
+                        currentRMS += std::sqrt(juce::jmax(0.0, energy) / windowSamples);
+                    }
+
+                    windowStartEnergy.pop_front();
+
+                    if (currentRMS > maxRMS)
+                    {
+                        maxRMS = currentRMS;
+                        hasPending = true;
+                        pendingEnd = position;
+                    }
+                }
+
+                if (hasPending && position >= pendingEnd + stepSize) commitPending();
+            }
+        }
+
+        juce::AudioBuffer<float>& finish()
+        {
+            if (hasPending) commitPending();
+
+            return result;
+        }
+
+    private:
+
+        juce::int64 nextWindowEnd() const
+        {
+            return nextWindowStart - (juce::int64)stepSize * (juce::int64)windowStartEnergy.size() + windowSamples;
+        }
+
+        void writeToRing(const juce::AudioBuffer<float>& block, int offset, int numSamples)
+        {
+            int ringPos = (int)(position % ringSize);
+            int firstPart = std::min(numSamples, ringSize - ringPos);
+
+            for (int ch = 0; ch < channels; ++ch)
+            {
+                ring.copyFrom(ch, ringPos, block, ch, offset, firstPart);
+
+                if (numSamples > firstPart) ring.copyFrom(ch, 0, block, ch, offset + firstPart, numSamples - firstPart);
+
+                auto* data = block.getReadPointer(ch, offset);
+                double energy = 0.0;
+
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    energy += (double)data[i] * data[i];
+                }
+
+                cumulativeEnergy[(size_t)ch] += energy;
+            }
+        }
+
+        void commitPending()
+        {
+            int ringPos = (int)((pendingEnd - windowSamples) % ringSize);
+            int firstPart = std::min(windowSamples, ringSize - ringPos);
+
+            for (int ch = 0; ch < channels; ++ch)
+            {
+                result.copyFrom(ch, 0, ring, ch, ringPos, firstPart);
+
+                if (windowSamples > firstPart) result.copyFrom(ch, firstPart, ring, ch, 0, windowSamples - firstPart);
+            }
+
+            hasPending = false;
+        }
+
+        int channels = 0;
+        juce::int64 total = 0;
+        juce::int64 position = 0;
+        int windowSamples = 0;
+        int stepSize = 1;
+        int ringSize = 0;
+        juce::AudioBuffer<float> ring;
+        juce::AudioBuffer<float> result;
+        std::vector<double> cumulativeEnergy;
+        std::deque<std::vector<double>> windowStartEnergy;
+        juce::int64 nextWindowStart = 0;
+        juce::int64 pendingEnd = 0;
+        bool hasPending = false;
+        double maxRMS = -1.0;
+    };
 };
\ No newline at end of file
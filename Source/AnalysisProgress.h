@@ -0,0 +1,91 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <memory>
+
+// Shared between one analysis and whoever started it: a cancellation flag that every stage polls between
+// blocks, and a 0-1 progress fraction per stage. Stages write only their own slot; any thread may read.
+class AnalysisProgress
+{
+public:
+
+    enum Stage
+    {
+        decoding,
+        loudness,
+        bpmPrep,
+        keyPrep,
+        bpmDetection,
+        keyDetection,
+        numStages
+    };
+
+    // Only call while no analysis is using this object
+    void reset()
+    {
+        cancelled = std::make_shared<std::atomic<bool>>(false);
+
+        for (auto& p : progress)
+        {
+            p.store(0.0f);
+        }
+    }
+
+    void cancel() { cancelled->store(true); }
+    bool isCancelled() const { return cancelled->load(); }
+
+    // For work that can outlive the analysis call, such as an external tool that is still being shut down
+    std::shared_ptr<const std::atomic<bool>> getCancelFlag() const { return cancelled; }
+
+    void setStageProgress(Stage stage, float fraction) { progress[(size_t)stage].store(juce::jlimit(0.0f, 1.0f, fraction)); }
+    float getStageProgress(Stage stage) const { return progress[(size_t)stage].load(); }
+
+    // Weighted by each stage's typical share of the total time
+    float getOverallProgress() const
+    {
+        static const std::array<float, numStages> weights = { 0.4f, 0.2f, 0.1f, 0.1f, 0.1f, 0.1f };
+
+        float total = 0.0f;
+
+        for (size_t i = 0; i < weights.size(); ++i)
+        {
+            total += weights[i] * progress[i].load();
+        }
+
+        return total;
+    }
+
+    // The earliest stage that has not finished yet
+    Stage getCurrentStage() const
+    {
+        for (int i = 0; i < numStages; ++i)
+        {
+            if (progress[(size_t)i].load() < 1.0f) return (Stage)i;
+        }
+
+        return numStages;
+    }
+
+    static juce::String getStageName(Stage stage)
+    {
+        switch (stage)
+        {
+            case decoding:     return "DECODING";
+            case loudness:     return "LOUDNESS";
+            case bpmPrep:      return "BPM PREPARATION";
+            case keyPrep:      return "KEY PREPARATION";
+            case bpmDetection: return "BPM DETECTION";
+            case keyDetection: return "KEY DETECTION";
+            case numStages:    break;
+        }
+
+        return "FINISHING";
+    }
+
+private:
+
+    std::shared_ptr<std::atomic<bool>> cancelled = std::make_shared<std::atomic<bool>>(false);
+    std::array<std::atomic<float>, numStages> progress {};
+};
\ No newline at end of file
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "SpectrumProcessor.h"
+#include "TrackAnalysisData.h"
+#include <JuceHeader.h>
+
+// One machine-readable record per analyzed track, as a single JSON line or a CSV row
+class AnalysisReport
+{
+public:
+
+    static juce::String toJson(const juce::File& audioFile, const TrackAnalysisData& data, const juce::String& error = {}, const SpectrumData* spectrum = nullptr)
+    {
+        auto* obj = new juce::DynamicObject();
+        juce::var record(obj);
+
+        obj->setProperty("file", audioFile.getFullPathName());
+
+        if (error.isNotEmpty())
+        {
+            obj->setProperty("error", error);
+
+            return juce::JSON::toString(record, true, 3);
+        }
+
+        obj->setProperty("durationSeconds", data.durationInSeconds);
+        obj->setProperty("sampleRate", data.sampleRate);
+        obj->setProperty("bpm", data.bpm);
+        obj->setProperty("bpmConfidence", data.bpmConfidence);
+        obj->setProperty("key", data.musicalKey);
+        obj->setProperty("camelot", data.camelotKey);
+        obj->setProperty("keyConfidence", data.keyConfidence);
+        obj->setProperty("integratedLufs", data.integratedLUFS);
+        obj->setProperty("shortTermMaxLufs", data.shortTermMaxLUFS);
+        obj->setProperty("momentaryMaxLufs", data.momentaryMaxLUFS);
+        obj->setProperty("loudnessRange", data.loudnessRange);
+        obj->setProperty("truePeakMax", data.truePeakMax);
+        obj->setProperty("plr", data.averageDynamicsPLR);
+        obj->setProperty("analysisMs", data.timeTotal);
+
+        if (spectrum != nullptr && !spectrum->isEmpty())
+        {
+            // Averaged stereo spectrum in dB, one value per FFT bin
+            juce::Array<juce::var> bins;
+
+            for (float magnitude : spectrum->avgStereo)
+            {
+                bins.add(std::round(juce::Decibels::gainToDecibels(magnitude / SpectrumProcessor::fftSize, -150.0f) * 100.0f) / 100.0f);
+            }
+
+            obj->setProperty("spectrumFftSize", SpectrumProcessor::fftSize);
+            obj->setProperty("spectrumAvgStereoDb", bins);
+        }
+
+        return juce::JSON::toString(record, true, 3);
+    }
+
+    static juce::String getCsvHeader()
+    {
+        return "file,durationSeconds,sampleRate,bpm,bpmConfidence,key,camelot,keyConfidence,integratedLufs,shortTermMaxLufs,momentaryMaxLufs,loudnessRange,truePeakMax,plr,analysisMs,error";
+    }
+
+    static juce::String toCsv(const juce::File& audioFile, const TrackAnalysisData& data, const juce::String& error = {})
+    {
+        juce::StringArray fields;
+
+        fields.add(escapeCsv(audioFile.getFullPathName()));
+
+        if (error.isNotEmpty())
+        {
+            for (int i = 0; i < 14; ++i)
+            {
+                fields.add({});
+            }
+
+            fields.add(escapeCsv(error));
+
+            return fields.joinIntoString(",");
+        }
+
+        fields.add(juce::String(data.durationInSeconds, 3));
+        fields.add(juce::String(data.sampleRate, 0));
+        fields.add(juce::String(data.bpm, 1));
+        fields.add(juce::String(data.bpmConfidence, 1));
+        fields.add(escapeCsv(data.musicalKey));
+        fields.add(escapeCsv(data.camelotKey));
+        fields.add(juce::String(data.keyConfidence, 1));
+        fields.add(juce::String(data.integratedLUFS, 2));
+        fields.add(juce::String(data.shortTermMaxLUFS, 2));
+        fields.add(juce::String(data.momentaryMaxLUFS, 2));
+        fields.add(juce::String(data.loudnessRange, 2));
+        fields.add(juce::String(data.truePeakMax, 2));
+        fields.add(juce::String(data.averageDynamicsPLR, 2));
+        fields.add(juce::String(data.timeTotal, 1));
+        fields.add({});
+
+        return fields.joinIntoString(",");
+    }
+
+private:
+
+    static juce::String escapeCsv(const juce::String& field)
+    {
+        if (!field.containsAnyOf(",\"\r\n")) return field;
+
+        return "\"" + field.replace("\"", "\"\"") + "\"";
+    }
+};
\ No newline at end of file
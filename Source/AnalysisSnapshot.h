@@ -0,0 +1,59 @@
+#pragma once
+
+#include "TrackAnalysisData.h"
+#include <JuceHeader.h>
+#include <atomic>
+#include <memory>
+
+// Everything the UI shows for one analysis request. A snapshot is filled on the analysis thread and
+// never modified after it has been published. Partial snapshots are published as stages finish; each
+// one holds every part finished so far, so a reader that skips some still misses nothing.
+struct AnalysisSnapshot
+{
+    int requestId = 0;
+    juce::File file;
+    juce::String cacheKey;
+    TrackAnalysisData data;
+
+    // Bit mask of AnalysisEngine::ResultPart values that are valid in data
+    int parts = 0;
+
+    // Set once the spectrum part has arrived; later partials and the final snapshot share the same data
+    std::shared_ptr<const SpectrumData> spectrum;
+
+    bool isComplete = false;
+
+    // Set on a final snapshot whose file could not be read; such a snapshot holds no parts
+    bool failed = false;
+
+    bool hasPart(int part) const { return (parts & part) != 0; }
+};
+
+// Single-slot hand-over of immutable snapshots from a producer thread to the message thread, built on
+// one atomic pointer exchange. Publishing replaces a snapshot the reader has not collected yet; the
+// reader always takes the newest one. Neither side ever blocks or sees a half-written result.
+template <typename Snapshot>
+class SnapshotMailbox
+{
+public:
+
+    ~SnapshotMailbox()
+    {
+        delete slot.exchange(nullptr);
+    }
+
+    void publish(std::unique_ptr<const Snapshot> snapshot)
+    {
+        delete slot.exchange(snapshot.release());
+    }
+
+    // Returns nullptr when nothing new has been published since the last call
+    std::unique_ptr<const Snapshot> collect()
+    {
+        return std::unique_ptr<const Snapshot>(slot.exchange(nullptr));
+    }
+
+private:
+
+    std::atomic<const Snapshot*> slot { nullptr };
+};
\ No newline at end of file
@@ -0,0 +1,329 @@
+#pragma once
+
+#include "AnalysisPrep.h"
+#include "SharedAudioSource.h"
+#include "SpectrumProcessor.h"
+#include "TrackAnalysisData.h"
+#include <JuceHeader.h>
+#include <cmath>
+
+extern "C"
+{
+    #include "libebur128/ebur128.h"
+}
+
+class LoudnessStage : public AudioBlockConsumer
+{
+public:
+
+    ~LoudnessStage() override
+    {
+        if (state != nullptr) ebur128_destroy(&state);
+    }
+
+    void prepare(int numChannels, double sampleRate, juce::int64 lengthInSamples) override
+    {
+        channels = numChannels;
+        state = ebur128_init((unsigned)numChannels, (unsigned)sampleRate, EBUR128_MODE_I | EBUR128_MODE_LRA | EBUR128_MODE_TRUE_PEAK | EBUR128_MODE_S | EBUR128_MODE_M);
+        interleavedBuffer.resize((size_t)(chunkSize * numChannels));
+    }
+
+    void processBlock(const juce::AudioBuffer<float>& block, int numSamples) override
+    {
+        if (state == nullptr) return;
+
+        // Momentary/short-term maxima are polled per chunk, so large decode blocks are split up
+        for (int offset = 0; offset < numSamples; offset += chunkSize)
+        {
+            int chunkSamples = std::min(chunkSize, numSamples - offset);
+
+            for (int i = 0; i < chunkSamples; ++i)
+            {
+                for (int ch = 0; ch < channels; ++ch)
+                {
+                    interleavedBuffer[i * channels + ch] = block.getSample(ch, offset + i);
+                }
+            }
+
+            ebur128_add_frames_float(state, interleavedBuffer.data(), (size_t)chunkSamples);
+
+            double currentMom = -1000.0;
+            double currentST = -1000.0;
+
+            if (ebur128_loudness_momentary(state, &currentMom) == EBUR128_SUCCESS)
+            {
+                if (currentMom > maxMomentary) maxMomentary = currentMom;
+            }
+
+            if (ebur128_loudness_shortterm(state, &currentST) == EBUR128_SUCCESS)
+            {
+                if (currentST > maxShortTerm) maxShortTerm = currentST;
+            }
+        }
+    }
+
+    void finish() override
+    {
+        if (state == nullptr) return;
+
+        double val = -100.0;
+
+        if (ebur128_loudness_global(state, &val) == EBUR128_SUCCESS) result.integratedLUFS = val;
+
+        if (ebur128_loudness_range(state, &val) == EBUR128_SUCCESS) result.loudnessRange = val;
+
+        if (maxMomentary > -900.0) result.momentaryMaxLUFS = maxMomentary;
+
+        if (maxShortTerm > -900.0) result.shortTermMaxLUFS = maxShortTerm;
+
+        double maxPeak = 0.0;
+
+        for (int i = 0; i < channels; ++i)
+        {
+            double chPeak = 0.0;
+
+            ebur128_true_peak(state, (unsigned)i, &chPeak);
+
+            if (chPeak > maxPeak) maxPeak = chPeak;
+        }
+
+        if (maxPeak > 0.000001) result.truePeakMax = 20.0 * std::log10(maxPeak);
+
+        if (result.integratedLUFS > -100.0 && result.truePeakMax > -100.0) result.averageDynamicsPLR = result.truePeakMax - result.integratedLUFS;
+    }
+
+    TrackAnalysisData result;
+
+private:
+
+    static constexpr int chunkSize = 4096;
+
+    ebur128_state* state = nullptr;
+    int channels = 0;
+    std::vector<float> interleavedBuffer;
+    double maxMomentary = -1000.0;
+    double maxShortTerm = -1000.0;
+};
+
+class PrepStage : public AudioBlockConsumer
+{
+public:
+
+    enum class Target { bpm, key };
+
+    explicit PrepStage(Target t) : target(t) {}
+
+    // Decimation, filtering and loudest-section search run block by block, so memory stays bounded by the
+    // crop window no matter how long the track is. Normalization is applied to the cropped result,
+    // which is equivalent because the filters are linear.
+    void prepare(int numChannels, double sr, juce::int64 lengthInSamples) override
+    {
+        peakMagnitude = 0.0f;
+
+        decimator.prepare(numChannels, sr, target == Target::bpm ? AnalysisPrep::bpmAnalysisRate : AnalysisPrep::keyAnalysisRate);
+        sampleRate = decimator.getOutputRate();
+
+        if (target == Target::bpm) bpmFilter.prepare(numChannels, sampleRate);
+        else keyFilter.prepare(numChannels, sampleRate);
+
+        juce::int64 decimatedLength = (lengthInSamples + decimator.getFactor() - 1) / decimator.getFactor();
+
+        collector.prepare(numChannels, sampleRate, target == Target::bpm ? 30.0 : 60.0, decimatedLength);
+    }
+
+    void processBlock(const juce::AudioBuffer<float>& block, int numSamples) override
+    {
+        peakMagnitude = juce::jmax(peakMagnitude, block.getMagnitude(0, numSamples));
+
+        int numDecimated = decimator.process(block, numSamples, scratch);
+
+        if (numDecimated == 0) return;
+
+        if (target == Target::bpm) bpmFilter.process(scratch, 0, numDecimated);
+        else keyFilter.process(scratch, 0, numDecimated);
+
+        collector.push(scratch, numDecimated);
+    }
+
+    void finish() override
+    {
+        buffer = std::move(collector.finish());
+
+        if (peakMagnitude < 0.001f) return;
+
+        float gainNeeded = -6.0f - juce::Decibels::gainToDecibels(peakMagnitude);
+        buffer.applyGain(juce::Decibels::decibelsToGain(gainNeeded));
+    }
+
+    juce::AudioBuffer<float> buffer;
+    double sampleRate = 0.0;
+
+private:
+
+    Target target;
+    AnalysisPrep::Decimator decimator;
+    AnalysisPrep::BpmFilter bpmFilter;
+    AnalysisPrep::KeyFilter keyFilter;
+    AnalysisPrep::LoudestSectionCollector collector;
+    juce::AudioBuffer<float> scratch;
+    float peakMagnitude = 0.0f;
+};
+
+// The whole track is streamed through the spectrum processor as it is decoded, which can also record its
+// spectrogram on request. For a quick look, only the loudest 30 s window is captured instead, and its loudest
+// 20 s are transformed once decoding ends; that spectrum always comes without a spectrogram.
+class SpectrumStage : public AudioBlockConsumer
+{
+public:
+
+    enum class Range { fullTrack, loudestSection };
+
+    explicit SpectrumStage(Range r, bool recordSpectrogram = false) : range(r), captureSpectrogram(recordSpectrogram) {}
+
+    void prepare(int numChannels, double sr, juce::int64 lengthInSamples) override
+    {
+        sampleRate = sr;
+
+        if (range == Range::fullTrack)
+        {
+            processor.reset(sampleRate, captureSpectrogram);
+
+            return;
+        }
+
+        totalSamples = lengthInSamples;
+        windowSize = (int)std::min((juce::int64)(targetDuration * sampleRate), lengthInSamples);
+        stepSize = (int)sampleRate;
+
+        buffer.setSize(numChannels, windowSize);
+        candidate.setSize(numChannels, windowSize);
+        buffer.clear();
+
+        // Until a louder section is found, the window starting at zero is captured
+        bestStart = 0;
+        bestFilled = 0;
+        candidateActive = false;
+        maxRMS = -1.0;
+    }
+
+    void processBlock(const juce::AudioBuffer<float>& block, int numSamples) override
+    {
+        if (range == Range::fullTrack)
+        {
+            processor.pushBlock(block, numSamples);
+
+            return;
+        }
+
+        juce::int64 blockStart = position;
+
+        for (int i = 0; i < numSamples; )
+        {
+            juce::int64 pos = blockStart + i;
+
+            // Scan points: the first second of every fifth second decides where the 30 s window starts
+            if (!candidateActive && pos < totalSamples - windowSize && pos % ((juce::int64)stepSize * 5) == 0)
+            {
+                candidateActive = true;
+                candidateStart = pos;
+                candidateFilled = 0;
+                candidateEnergy[0] = candidateEnergy[1] = 0.0;
+            }
+
+            int run = numSamples - i;
+
+            if (candidateActive) run = std::min(run, (int)(candidateStart + stepSize - pos));
+            else
+            {
+                juce::int64 nextScan = ((pos / ((juce::int64)stepSize * 5)) + 1) * (juce::int64)stepSize * 5;
+
+                if (nextScan < totalSamples - windowSize) run = (int)std::min((juce::int64)run, nextScan - pos);
+            }
+
+            capture(buffer, bestStart, bestFilled, block, i, run);
+
+            if (candidateActive)
+            {
+                capture(candidate, candidateStart, candidateFilled, block, i, run);
+
+                for (int ch = 0; ch < std::min(2, block.getNumChannels()); ++ch)
+                {
+                    auto* data = block.getReadPointer(ch, i);
+
+                    for (int j = 0; j < run; ++j)
+                    {
+                        candidateEnergy[ch] += (double)data[j] * data[j];
+                    }
+                }
+
+                if (pos + run >= candidateStart + stepSize)
+                {
+                    double currentRMS = std::sqrt(candidateEnergy[0] / stepSize);
+
+                    if (block.getNumChannels() > 1) currentRMS = (currentRMS + std::sqrt(candidateEnergy[1] / stepSize)) * 0.5;
+
+                    if (currentRMS > maxRMS)
+                    {
+                        maxRMS = currentRMS;
+                        std::swap(buffer, candidate);
+                        bestStart = candidateStart;
+                        bestFilled = candidateFilled;
+                    }
+
+                    candidateActive = false;
+                }
+            }
+
+            i += run;
+        }
+
+        position += numSamples;
+    }
+
+    void finish() override
+    {
+        result = range == Range::fullTrack ? processor.getResult() : processor.process(buffer, sampleRate);
+
+        buffer.setSize(0, 0);
+        candidate.setSize(0, 0);
+    }
+
+    SpectrumData result;
+
+private:
+
+    static constexpr double targetDuration = 30.0;
+
+    void capture(juce::AudioBuffer<float>& target, juce::int64 start, int& filled, const juce::AudioBuffer<float>& block, int offset, int numSamples)
+    {
+        juce::int64 pos = position + offset;
+
+        if (pos < start || filled >= windowSize) return;
+
+        int toCopy = std::min(numSamples, windowSize - filled);
+
+        for (int ch = 0; ch < target.getNumChannels(); ++ch)
+        {
+            target.copyFrom(ch, filled, block, ch, offset, toCopy);
+        }
+
+        filled += toCopy;
+    }
+
+    Range range;
+    bool captureSpectrogram;
+    SpectrumProcessor processor;
+    juce::AudioBuffer<float> buffer, candidate;
+    double sampleRate = 0.0;
+    juce::int64 totalSamples = 0;
+    juce::int64 position = 0;
+    int windowSize = 0;
+    int stepSize = 0;
+    juce::int64 bestStart = 0;
+    int bestFilled = 0;
+    juce::int64 candidateStart = 0;
+    int candidateFilled = 0;
+    bool candidateActive = false;
+    double candidateEnergy[2] = { 0.0, 0.0 };
+    double maxRMS = -1.0;
+};
\ No newline at end of file
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Process-wide worker pool, shared through juce::SharedResourcePointer so every engine, batch job and
+// plugin instance draws from the same bounded set of workers. All workers take from one queue, so an
+// idle worker picks up whatever stage is pending. Tasks may carry a group tag: a worker that waits on a
+// group runs that group's queued tasks itself instead of sleeping, which keeps nested waits from
+// deadlocking however small the pool is, while never pulling in unrelated work that would hold up its
+// own caller. Any other thread only waits, so no more than getNumWorkers() threads ever compute at once.
+class AnalysisThreadPool
+{
+public:
+
+    AnalysisThreadPool()
+    {
+        int numWorkers = juce::jmax(2, juce::SystemStats::getNumCpus() - 1);
+
+        for (int i = 0; i < numWorkers; ++i)
+        {
+            threads.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~AnalysisThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            shuttingDown = true;
+        }
+
+        taskAvailable.notify_all();
+
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+    }
+
+    int getNumWorkers() const { return (int)threads.size(); }
+
+    bool isWorkerThread() const { return currentWorkerPool() == this; }
+
+    void submit(std::function<void()> task, const void* group = nullptr)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back({ std::move(task), group });
+        }
+
+        taskAvailable.notify_one();
+        stateChanged.notify_all();
+    }
+
+    // Runs one queued task of the group on the calling thread; returns false if there was none
+    bool runPendingTask(const void* group)
+    {
+        std::function<void()> task;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            auto it = findTask(group);
+
+            if (it == tasks.end()) return false;
+
+            task = std::move(it->run);
+            tasks.erase(it);
+        }
+
+        task();
+        stateChanged.notify_all();
+
+        return true;
+    }
+
+    // Removes the group's queued tasks without running them and hands them to the caller
+    std::vector<std::function<void()>> takeTasks(const void* group)
+    {
+        std::vector<std::function<void()>> taken;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            for (auto it = tasks.begin(); it != tasks.end();)
+            {
+                if (it->group == group)
+                {
+                    taken.push_back(std::move(it->run));
+                    it = tasks.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+
+        return taken;
+    }
+
+    // A pool worker waiting on a group helps with that group's tasks; ungrouped waits and other threads just wait
+    template <typename Predicate>
+    void waitUntil(Predicate isDone, const void* group = nullptr)
+    {
+        bool canHelp = group != nullptr && isWorkerThread();
+
+        while (!isDone())
+        {
+            if (canHelp && runPendingTask(group)) continue;
+
+            // The timeout covers completions signalled between the check above and the wait
+            std::unique_lock<std::mutex> lock(mutex);
+            if (canHelp) stateChanged.wait_for(lock, std::chrono::milliseconds(1), [this, group] { return findTask(group) != tasks.end(); });
+            else stateChanged.wait_for(lock, std::chrono::milliseconds(1));
+        }
+    }
+
+private:
+
+    struct Task
+    {
+        std::function<void()> run;
+        const void* group = nullptr;
+    };
+
+    static AnalysisThreadPool*& currentWorkerPool()
+    {
+        thread_local AnalysisThreadPool* pool = nullptr;
+
+        return pool;
+    }
+
+    std::deque<Task>::iterator findTask(const void* group)
+    {
+        return std::find_if(tasks.begin(), tasks.end(), [group](const Task& t) { return t.group == group; });
+    }
+
+    void workerLoop()
+    {
+        currentWorkerPool() = this;
+
+        for (;;)
+        {
+            std::function<void()> task;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                taskAvailable.wait(lock, [this] { return shuttingDown || !tasks.empty(); });
+
+                if (tasks.empty()) return;
+
+                task = std::move(tasks.front().run);
+                tasks.pop_front();
+            }
+
+            task();
+            stateChanged.notify_all();
+        }
+    }
+
+    std::vector<std::thread> threads;
+    std::deque<Task> tasks;
+    std::mutex mutex;
+    std::condition_variable taskAvailable, stateChanged;
+    bool shuttingDown = false;
+};
+
+// Small dependency-aware task graph: a node is handed to the pool as soon as all of its dependencies
+// have finished. Nodes are added up front, then run() executes the graph and returns when every node is done.
+// Once the graph is cancelled no further node starts: queued nodes are skipped and run() only waits for
+// the ones already running.
+class AnalysisTaskGraph
+{
+public:
+
+    using NodeId = int;
+
+    explicit AnalysisTaskGraph(AnalysisThreadPool& p) : pool(p) {}
+
+    NodeId add(std::function<void()> task, std::vector<NodeId> dependencies = {})
+    {
+        NodeId id = (NodeId)nodes.size();
+
+        nodes.push_back(std::make_unique<Node>());
+        nodes.back()->task = std::move(task);
+        nodes.back()->numPending = (int)dependencies.size();
+
+        for (NodeId dependency : dependencies)
+        {
+            nodes[(size_t)dependency]->dependents.push_back(id);
+        }
+
+        return id;
+    }
+
+    // A pool worker that calls this helps with this graph's nodes while it waits; any other thread just waits
+    void run(std::function<bool()> isCancelled = nullptr)
+    {
+        remaining = (int)nodes.size();
+
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            if (nodes[i]->numPending == 0) schedule((NodeId)i);
+        }
+
+        pool.waitUntil([this, &isCancelled]
+        {
+            if (isCancelled != nullptr && isCancelled()) cancelled = true;
+
+            // Queued nodes are taken back and finished here without running, so a cancelled graph never
+            // waits for a free worker
+            if (cancelled)
+            {
+                for (auto& task : pool.takeTasks(this))
+                {
+                    task();
+                }
+            }
+
+            return remaining.load() == 0;
+        }, this);
+    }
+
+private:
+
+    struct Node
+    {
+        std::function<void()> task;
+        std::atomic<int> numPending { 0 };
+        std::vector<NodeId> dependents;
+    };
+
+    void schedule(NodeId id)
+    {
+        pool.submit([this, id]
+        {
+            auto& node = *nodes[(size_t)id];
+
+            if (!cancelled) node.task();
+
+            for (NodeId dependent : node.dependents)
+            {
+                if (--nodes[(size_t)dependent]->numPending == 0) schedule(dependent);
+            }
+
+            // Last access to the graph: run() may return as soon as this reaches zero
+            --remaining;
+        }, this);
+    }
+
+    AnalysisThreadPool& pool;
+    std::vector<std::unique_ptr<Node>> nodes;
+    std::atomic<int> remaining { 0 };
+    std::atomic<bool> cancelled { false };
+};
\ No newline at end of file
@@ -0,0 +1,252 @@
+#pragma once
+
+#include "AnalysisCache.h"
+#include "AnalysisEngine.h"
+#include <JuceHeader.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Background queue for folder and multi-file drops. There is one runner per pool worker, each with a file
+// in flight, and all of their stages go to the shared worker pool, so a worker that runs out of work on one
+// file picks up stages of another and one long file never leaves cores idle. Runners only wait on the pool
+// and never compute, so the CPU is not oversubscribed.
+// Files can be added at any time, including while a batch is running. Destroying the queue cancels the
+// files in flight, so it returns within a block or two instead of waiting for them to finish.
+class BatchAnalysisQueue
+{
+public:
+
+    enum class Status
+    {
+        queued,
+        analyzing,
+        done,
+        cached,
+        failed
+    };
+
+    struct Item
+    {
+        juce::File file;
+        Status status = Status::queued;
+        TrackAnalysisData data;
+        juce::String cacheKey;
+        float progress = 0.0f;
+        int runner = -1;
+    };
+
+    struct Progress
+    {
+        int numItems = 0;
+        int numFinished = 0;
+        int numFailed = 0;
+        int numAnalyzing = 0;
+        double tracksPerMinute = 0.0;
+    };
+
+    ~BatchAnalysisQueue()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            shuttingDown = true;
+
+            for (auto& progress : runnerProgress)
+            {
+                progress->cancel();
+            }
+        }
+
+        itemAdded.notify_all();
+
+        for (auto& runner : runners)
+        {
+            runner.join();
+        }
+    }
+
+    void addFiles(const juce::Array<juce::File>& files)
+    {
+        if (files.isEmpty()) return;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            // Throughput is measured per batch: it restarts when files arrive at an idle queue
+            if (numPending == 0)
+            {
+                batchStartTime = juce::Time::getMillisecondCounterHiRes();
+                numFinishedInBatch = 0;
+            }
+
+            for (auto& file : files)
+            {
+                items.push_back({ file });
+            }
+
+            numPending += files.size();
+
+            // Runners start on first use and then wait for more files
+            while ((int)runners.size() < pool->getNumWorkers())
+            {
+                runnerProgress.push_back(std::make_unique<AnalysisProgress>());
+                runners.emplace_back([this, runner = (int)runners.size(), progress = runnerProgress.back().get()]
+                {
+                    runnerLoop(runner, *progress);
+                });
+            }
+        }
+
+        changeCount++;
+        itemAdded.notify_all();
+    }
+
+    int getNumItems() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        return (int)items.size();
+    }
+
+    Item getItem(int index) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (!juce::isPositiveAndBelow(index, (int)items.size())) return {};
+
+        Item item = items[(size_t)index];
+
+        if (item.status == Status::analyzing) item.progress = runnerProgress[(size_t)item.runner]->getOverallProgress();
+        else if (item.status != Status::queued) item.progress = 1.0f;
+
+        return item;
+    }
+
+    Progress getProgress() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        Progress progress;
+        progress.numItems = (int)items.size();
+
+        for (auto& item : items)
+        {
+            if (item.status == Status::done || item.status == Status::cached) progress.numFinished++;
+            else if (item.status == Status::failed) progress.numFailed++;
+            else if (item.status == Status::analyzing) progress.numAnalyzing++;
+        }
+
+        double elapsedMinutes = (juce::Time::getMillisecondCounterHiRes() - batchStartTime) / 60000.0;
+
+        if (numFinishedInBatch > 0 && elapsedMinutes > 0.0) progress.tracksPerMinute = numFinishedInBatch / elapsedMinutes;
+
+        return progress;
+    }
+
+    bool isBusy() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        return numPending > 0;
+    }
+
+    // Applies to files that start after the call; files already in flight keep their range
+    void setSpectrumLoudestSectionOnly(bool loudestSectionOnly) { spectrumLoudestSectionOnly = loudestSectionOnly; }
+
+    // Increases whenever an item is added or changes status, so the UI only refreshes when needed
+    int getChangeCount() const { return changeCount.load(); }
+
+    static juce::String getStatusText(Status status)
+    {
+        switch (status)
+        {
+            case Status::queued:    return "QUEUED";
+            case Status::analyzing: return "ANALYZING";
+            case Status::done:      return "DONE";
+            case Status::cached:    return "CACHED";
+            case Status::failed:    return "FAILED";
+        }
+
+        return {};
+    }
+
+private:
+
+    void runnerLoop(int runner, AnalysisProgress& progress)
+    {
+        AnalysisEngine engine;
+        AnalysisCache cache { AnalysisEngine::settingsVersion };
+
+        for (;;)
+        {
+            size_t index = 0;
+            juce::File file;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                itemAdded.wait(lock, [this] { return shuttingDown || nextItem < items.size(); });
+
+                if (shuttingDown) return;
+
+                index = nextItem++;
+                items[index].status = Status::analyzing;
+                items[index].runner = runner;
+                file = items[index].file;
+
+                // Reset under the lock, so it never races with the cancellation in the destructor
+                progress.reset();
+            }
+
+            changeCount++;
+
+            engine.spectrumLoudestSectionOnly = spectrumLoudestSectionOnly;
+
+            double start = juce::Time::getMillisecondCounterHiRes();
+            juce::String cacheKey = cache.makeKey(file, engine.getCacheVariant());
+            TrackAnalysisData data;
+            SpectrumData spectrum;
+            Status status = Status::cached;
+
+            if (!cache.load(cacheKey, data, spectrum))
+            {
+                data = engine.analyzeFile(file, &spectrum, &progress);
+
+                if (progress.isCancelled()) return;
+
+                status = data.sampleRate > 0 ? Status::done : Status::failed;
+
+                if (status == Status::done) cache.store(cacheKey, data, spectrum);
+            }
+
+            data.timeTotal = juce::Time::getMillisecondCounterHiRes() - start;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                items[index].status = status;
+                items[index].data = data;
+                items[index].cacheKey = status != Status::failed ? cacheKey : juce::String();
+
+                numPending--;
+                numFinishedInBatch++;
+            }
+
+            changeCount++;
+        }
+    }
+
+    juce::SharedResourcePointer<AnalysisThreadPool> pool;
+    std::vector<std::thread> runners;
+    std::vector<std::unique_ptr<AnalysisProgress>> runnerProgress;
+    std::vector<Item> items;
+    size_t nextItem = 0;
+    int numPending = 0;
+    int numFinishedInBatch = 0;
+    double batchStartTime = 0.0;
+    bool shuttingDown = false;
+    std::atomic<bool> spectrumLoudestSectionOnly { false };
+    std::atomic<int> changeCount { 0 };
+    mutable std::mutex mutex;
+    std::condition_variable itemAdded;
+};
\ No newline at end of file
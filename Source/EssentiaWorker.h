@@ -0,0 +1,211 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+
+// Resident runner for the Essentia fallback tools. Worker threads are started on first use and
+// then stay alive for the lifetime of the engine, taking jobs from a queue. A tool that hangs is
+// killed at the deadline, and a tool that crashes, hangs or prints nothing is restarted once before
+// the job gives up. A cancelled job's tool is killed right away, so no child process outlives the
+// analysis that started it. Each tool is started, polled and killed by the worker thread that ran
+// its job; a helper thread only drains its output.
+class EssentiaWorker
+{
+public:
+
+    struct Job
+    {
+        juce::File exeFile;
+        juce::File audioFile;
+        juce::File outputFile;
+        bool hasOutputFileArg = false;
+        std::shared_ptr<const std::atomic<bool>> cancelFlag;
+
+        bool isCancelled() const { return cancelFlag != nullptr && cancelFlag->load(); }
+    };
+
+    explicit EssentiaWorker(int numSlots = 2) : numWorkers(numSlots) {}
+
+    // Queued jobs are not run and running tools are killed, so teardown never waits on a tool
+    ~EssentiaWorker()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            shuttingDown = true;
+        }
+
+        jobAvailable.notify_all();
+
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+    }
+
+    // The future yields the tool's stdout, or the content of its output file when it writes one
+    std::future<juce::String> submit(Job job)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (threads.empty())
+        {
+            for (int i = 0; i < numWorkers; ++i)
+            {
+                threads.emplace_back([this] { workerLoop(); });
+            }
+        }
+
+        jobs.push_back({ std::move(job), std::promise<juce::String>() });
+        auto future = jobs.back().result.get_future();
+        jobAvailable.notify_one();
+
+        return future;
+    }
+
+    int getNumRestarts() const { return restarts.load(); }
+
+private:
+
+    struct PendingJob
+    {
+        Job job;
+        std::promise<juce::String> result;
+    };
+
+    static constexpr int maxAttempts = 2;
+    static constexpr double jobTimeoutMs = 20000.0;
+
+    void workerLoop()
+    {
+        for (;;)
+        {
+            PendingJob pending;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobAvailable.wait(lock, [this] { return shuttingDown || !jobs.empty(); });
+
+                // Queued jobs are answered with empty output on shutdown so no caller waits forever
+                if (shuttingDown)
+                {
+                    for (auto& queued : jobs)
+                    {
+                        queued.result.set_value({});
+                    }
+
+                    jobs.clear();
+
+                    return;
+                }
+
+                pending = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            pending.result.set_value(runWithRestart(pending.job));
+        }
+    }
+
+    bool isStopped(const Job& job) const { return job.isCancelled() || shuttingDown.load(); }
+
+    juce::String runWithRestart(const Job& job)
+    {
+        for (int attempt = 0; attempt < maxAttempts && !isStopped(job); ++attempt)
+        {
+            bool failed = false;
+            juce::String output = runOnce(job, failed);
+
+            if (!failed) return output;
+
+            restarts++;
+        }
+
+        return {};
+    }
+
+    juce::String runOnce(const Job& job, bool& failed)
+    {
+        failed = false;
+
+        if (!job.exeFile.existsAsFile()) return {};
+
+        if (job.outputFile.exists()) job.outputFile.deleteFile();
+
+        // Essentia Key Arguments: "input" "output"; Essentia BPM Arguments: "input" (prints to stdout)
+        juce::StringArray args { job.exeFile.getFullPathName(), job.audioFile.getFullPathName() };
+
+        if (job.hasOutputFileArg) args.add(job.outputFile.getFullPathName());
+
+        juce::ChildProcess process;
+
+        if (!process.start(args))
+        {
+            failed = true;
+
+            return {};
+        }
+
+        // readProcessOutput blocks until its buffer fills or the tool exits, so stdout is drained on a helper
+        // thread; that way a chatty tool never stalls on a full pipe and a silent one never stalls the checks
+        // below. The helper only reads, and the pipe ends once the tool has exited or been killed.
+        juce::MemoryOutputStream stdOut;
+
+        std::thread reader([&process, &stdOut]
+        {
+            char chunk[4096];
+
+            for (int bytesRead; (bytesRead = process.readProcessOutput(chunk, (int)sizeof(chunk))) > 0;)
+            {
+                stdOut.write(chunk, (size_t)bytesRead);
+            }
+        });
+
+        double deadline = juce::Time::getMillisecondCounterHiRes() + jobTimeoutMs;
+        bool stopped = false;
+
+        while (process.isRunning())
+        {
+            if (isStopped(job) || juce::Time::getMillisecondCounterHiRes() > deadline)
+            {
+                process.kill();
+                stopped = true;
+
+                break;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+
+        reader.join();
+
+        if (stopped)
+        {
+            // A cancelled job is not a failure worth retrying
+            failed = !isStopped(job);
+
+            return {};
+        }
+
+        // Success is judged by the output the engine parses, not by the exit code
+        juce::String output = stdOut.toString();
+
+        if (job.hasOutputFileArg) output = job.outputFile.existsAsFile() ? job.outputFile.loadFileAsString() : juce::String();
+
+        failed = output.isEmpty();
+
+        return output;
+    }
+
+    int numWorkers;
+    std::vector<std::thread> threads;
+    std::deque<PendingJob> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::atomic<bool> shuttingDown { false };
+    std::atomic<int> restarts { 0 };
+};
\ No newline at end of file
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <cmath>
+#include <vector>
+
+// In-process tempo estimator: spectral-flux onset envelope, autocorrelation and a comb/tempo-prior
+// search. Runs on the buffer prepared by AnalysisPrep::applyBpmFilter and is fully deterministic.
+class NativeBpmDetector
+{
+public:
+
+    struct Result
+    {
+        double bpm = 0.0;
+        double confidence = 0.0;
+    };
+
+    static Result estimate(const juce::AudioBuffer<float>& buffer, double sampleRate)
+    {
+        Result result;
+
+        if (sampleRate <= 0 || buffer.getNumChannels() == 0) return result;
+
+        double envelopeRate = 0.0;
+        auto envelope = computeOnsetEnvelope(buffer, sampleRate, envelopeRate);
+
+        int minLag = (int)std::floor(envelopeRate * 60.0 / maxBpm);
+        int maxLag = (int)std::ceil(envelopeRate * 60.0 / minBpm);
+
+        int numLags = (maxLag + 1) * combHarmonics + 2;
+
+        if ((int)envelope.size() < numLags) return result;
+
+        auto acf = computeAutocorrelation(envelope, numLags);
+
+        if (acf[0] <= 0.0f) return result;
+
+        // Comb over the first harmonics of each lag, weighted by a log-normal prior around 120 BPM
+        std::vector<float> score((size_t)maxLag + 2, 0.0f);
+        int bestLag = 0;
+
+        for (int lag = minLag; lag <= maxLag; ++lag)
+        {
+            float sum = 0.0f;
+
+            // The k-th harmonic of a fractional lag can sit up to k/2 steps away from lag * k
+            for (int k = 1; k <= combHarmonics; ++k)
+            {
+                float peak = acf[(size_t)(lag * k)];
+
+                for (int j = lag * k - k / 2; j <= lag * k + k / 2; ++j)
+                {
+                    peak = juce::jmax(peak, acf[(size_t)j]);
+                }
+
+                sum += peak / (float)k;
+            }
+
+            double bpm = envelopeRate * 60.0 / lag;
+            double octaves = std::log2(bpm / priorCentreBpm) / priorWidthOctaves;
+
+            score[(size_t)lag] = sum * (float)std::exp(-0.5 * octaves * octaves);
+
+            if (bestLag == 0 || score[(size_t)lag] > score[(size_t)bestLag]) bestLag = lag;
+        }
+
+        if (bestLag <= 0 || score[(size_t)bestLag] <= 0.0f) return result;
+
+        // Refine on the highest harmonic peak, where one lag step is a much smaller tempo step
+        double refinedLag = bestLag;
+        int harmonicLag = bestLag * combHarmonics;
+        int peak = harmonicLag;
+
+        for (int lag = harmonicLag - combHarmonics; lag <= harmonicLag + combHarmonics; ++lag)
+        {
+            if (lag > 0 && lag + 1 < (int)acf.size() && acf[(size_t)lag] > acf[(size_t)peak]) peak = lag;
+        }
+
+        if (peak > 0 && peak + 1 < (int)acf.size()) refinedLag = (peak + parabolicOffset(acf, peak)) / combHarmonics;
+
+        result.bpm = envelopeRate * 60.0 / refinedLag;
+
+        // Periodicity strength of the winning lag with the DC part removed, so aperiodic input scores low;
+        // mapped like the Essentia confidence
+        double mean = 0.0;
+
+        for (float v : envelope)
+        {
+            mean += v;
+        }
+
+        mean /= (double)envelope.size();
+
+        double variance = acf[0] - mean * mean;
+
+        if (variance <= 0.0) return result;
+
+        double strength = juce::jmax(0.0, (acf[(size_t)bestLag] - mean * mean) / variance);
+        result.confidence = juce::jlimit(0.0, 100.0, std::sqrt(strength) * 100.0);
+
+        return result;
+    }
+
+private:
+
+    static constexpr double minBpm = 60.0;
+    static constexpr double maxBpm = 200.0;
+    static constexpr double priorCentreBpm = 120.0;
+    static constexpr double priorWidthOctaves = 1.0;
+    static constexpr int combHarmonics = 4;
+    static constexpr double frameSeconds = 0.023;
+
+    static std::vector<float> computeOnsetEnvelope(const juce::AudioBuffer<float>& buffer, double sampleRate, double& envelopeRate)
+    {
+        int fftOrder = juce::jlimit(8, 13, (int)std::round(std::log2(sampleRate * frameSeconds)));
+        int frameSize = 1 << fftOrder;
+        int hopSize = frameSize / 2;
+        int numBins = frameSize / 2;
+        int numSamples = buffer.getNumSamples();
+        int numChannels = buffer.getNumChannels();
+
+        envelopeRate = sampleRate / hopSize;
+
+        std::vector<float> envelope;
+
+        if (numSamples < frameSize) return envelope;
+
+        juce::dsp::FFT fft(fftOrder);
+        juce::dsp::WindowingFunction<float> window((size_t)frameSize, juce::dsp::WindowingFunction<float>::hann, false);
+        std::vector<float> fftData((size_t)frameSize * 2, 0.0f);
+        std::vector<float> previous((size_t)numBins, 0.0f);
+
+        envelope.reserve((size_t)((numSamples - frameSize) / hopSize + 1));
+
+        for (int start = 0; start + frameSize <= numSamples; start += hopSize)
+        {
+            std::fill(fftData.begin(), fftData.end(), 0.0f);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                auto* data = buffer.getReadPointer(ch, start);
+
+                for (int i = 0; i < frameSize; ++i)
+                {
+                    fftData[(size_t)i] += data[i];
+                }
+            }
+
+            window.multiplyWithWindowingTable(fftData.data(), (size_t)frameSize);
+            fft.performFrequencyOnlyForwardTransform(fftData.data());
+
+            // Half-wave rectified difference of log-compressed magnitudes
+            float flux = 0.0f;
+            float scale = 1.0f / (float)(numChannels * frameSize);
+
+            for (int k = 1; k < numBins; ++k)
+            {
+                float logMag = std::log1p(1000.0f * fftData[(size_t)k] * scale);
+                float diff = logMag - previous[(size_t)k];
+
+                if (diff > 0.0f) flux += diff;
+
+                previous[(size_t)k] = logMag;
+            }
+
+            envelope.push_back(flux);
+        }
+
+        if (!envelope.empty()) envelope[0] = 0.0f;
+
+        // Remove the slowly varying level (about 1 s moving average) and keep onsets only
+        int radius = juce::jmax(1, (int)(envelopeRate * 0.5));
+        std::vector<double> prefix(envelope.size() + 1, 0.0);
+
+        for (size_t i = 0; i < envelope.size(); ++i)
+        {
+            prefix[i + 1] = prefix[i] + envelope[i];
+        }
+
+        std::vector<float> detrended(envelope.size());
+
+        for (int i = 0; i < (int)envelope.size(); ++i)
+        {
+            int lo = juce::jmax(0, i - radius);
+            int hi = juce::jmin((int)envelope.size(), i + radius + 1);
+            float mean = (float)((prefix[(size_t)hi] - prefix[(size_t)lo]) / (hi - lo));
+
+            detrended[(size_t)i] = juce::jmax(0.0f, envelope[(size_t)i] - mean);
+        }
+
+        return detrended;
+    }
+
+    static std::vector<float> computeAutocorrelation(const std::vector<float>& envelope, int numLags)
+    {
+        int size = (int)envelope.size();
+        numLags = juce::jmin(numLags, size);
+
+        std::vector<float> acf((size_t)numLags, 0.0f);
+
+        for (int lag = 0; lag < numLags; ++lag)
+        {
+            double sum = 0.0;
+
+            for (int i = 0; i + lag < size; ++i)
+            {
+                sum += (double)envelope[(size_t)i] * envelope[(size_t)(i + lag)];
+            }
+
+            acf[(size_t)lag] = (float)(sum / (size - lag));
+        }
+
+        return acf;
+    }
+
+    static double parabolicOffset(const std::vector<float>& data, int index)
+    {
+        double left = data[(size_t)index - 1];
+        double centre = data[(size_t)index];
+        double right = data[(size_t)index + 1];
+        double denominator = left - 2.0 * centre + right;
+
+        if (std::abs(denominator) < 1e-12) return 0.0;
+
+        return juce::jlimit(-0.5, 0.5, 0.5 * (left - right) / denominator);
+    }
+};
\ No newline at end of file
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <cmath>
+#include <vector>
+
+// In-process key estimator: a harmonic pitch class profile accumulated over an STFT, correlated
+// against Krumhansl-Kessler major/minor profiles in all twelve transpositions. Runs on the buffer
+// prepared by AnalysisPrep::applyKeyFilter and is fully deterministic.
+class NativeKeyDetector
+{
+public:
+
+    struct Result
+    {
+        juce::String key;
+        juce::String scale;
+        double strength = 0.0;
+    };
+
+    static Result estimate(const juce::AudioBuffer<float>& buffer, double sampleRate)
+    {
+        Result result;
+
+        if (sampleRate <= 0 || buffer.getNumChannels() == 0) return result;
+
+        auto chroma = computeChroma(buffer, sampleRate);
+
+        double total = 0.0;
+
+        for (double v : chroma)
+        {
+            total += v;
+        }
+
+        if (total <= 0.0) return result;
+
+        static const std::array<double, 12> majorProfile = { 6.35, 2.23, 3.48, 2.33, 4.38, 4.09, 2.52, 5.19, 2.39, 3.66, 2.29, 2.88 };
+        static const std::array<double, 12> minorProfile = { 6.33, 2.68, 3.52, 5.38, 2.60, 3.53, 2.54, 4.75, 3.98, 2.69, 3.34, 3.17 };
+        static const char* keyNames[12] = { "C", "C#", "D", "Eb", "E", "F", "F#", "G", "Ab", "A", "Bb", "B" };
+
+        double bestCorrelation = -2.0;
+
+        for (int tonic = 0; tonic < 12; ++tonic)
+        {
+            double major = correlate(chroma, majorProfile, tonic);
+            double minor = correlate(chroma, minorProfile, tonic);
+
+            // Ties are resolved towards the lower tonic and major, so results never depend on ordering noise
+            if (major > bestCorrelation)
+            {
+                bestCorrelation = major;
+                result.key = keyNames[tonic];
+                result.scale = "major";
+            }
+
+            if (minor > bestCorrelation)
+            {
+                bestCorrelation = minor;
+                result.key = keyNames[tonic];
+                result.scale = "minor";
+            }
+        }
+
+        result.strength = juce::jmax(0.0, bestCorrelation);
+
+        return result;
+    }
+
+private:
+
+    static constexpr double minFrequency = 100.0;
+    static constexpr double maxFrequency = 5000.0;
+    static constexpr double referenceFrequency = 440.0;
+    static constexpr double frameSeconds = 0.186;
+
+    // Each frame's profile is normalized to unit maximum before summing, so loud passages do not dominate
+    static std::array<double, 12> computeChroma(const juce::AudioBuffer<float>& buffer, double sampleRate)
+    {
+        std::array<double, 12> chroma {};
+
+        int fftOrder = juce::jlimit(10, 15, (int)std::round(std::log2(sampleRate * frameSeconds)));
+        int frameSize = 1 << fftOrder;
+        int hopSize = frameSize / 2;
+        int numSamples = buffer.getNumSamples();
+        int numChannels = buffer.getNumChannels();
+
+        if (numSamples < frameSize) return chroma;
+
+        // Bin-to-pitch-class table with a cosine-squared weight around each semitone centre
+        int firstBin = juce::jmax(1, (int)std::ceil(minFrequency * frameSize / sampleRate));
+        int lastBin = juce::jmin(frameSize / 2 - 1, (int)std::floor(maxFrequency * frameSize / sampleRate));
+
+        std::vector<int> binPitchClass;
+        std::vector<float> binWeight;
+
+        for (int k = firstBin; k <= lastBin; ++k)
+        {
+            double semitones = 12.0 * std::log2(k * sampleRate / frameSize / referenceFrequency) + 9.0;
+            double nearest = std::round(semitones);
+            double cosine = std::cos(juce::MathConstants<double>::pi * (semitones - nearest));
+
+            binPitchClass.push_back((((int)nearest % 12) + 12) % 12);
+            binWeight.push_back((float)(cosine * cosine));
+        }
+
+        juce::dsp::FFT fft(fftOrder);
+        juce::dsp::WindowingFunction<float> window((size_t)frameSize, juce::dsp::WindowingFunction<float>::hann, false);
+        std::vector<float> fftData((size_t)frameSize * 2, 0.0f);
+
+        for (int start = 0; start + frameSize <= numSamples; start += hopSize)
+        {
+            std::fill(fftData.begin(), fftData.end(), 0.0f);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                auto* data = buffer.getReadPointer(ch, start);
+
+                for (int i = 0; i < frameSize; ++i)
+                {
+                    fftData[(size_t)i] += data[i];
+                }
+            }
+
+            window.multiplyWithWindowingTable(fftData.data(), (size_t)frameSize);
+            fft.performFrequencyOnlyForwardTransform(fftData.data());
+
+            std::array<double, 12> frame {};
+
+            for (size_t i = 0; i < binPitchClass.size(); ++i)
+            {
+                float magnitude = fftData[(size_t)firstBin + i];
+
+                frame[(size_t)binPitchClass[i]] += (double)binWeight[i] * magnitude * magnitude;
+            }
+
+            double frameMax = 0.0;
+
+            for (double v : frame)
+            {
+                frameMax = juce::jmax(frameMax, v);
+            }
+
+            if (frameMax <= 0.0) continue;
+
+            for (int pc = 0; pc < 12; ++pc)
+            {
+                chroma[(size_t)pc] += frame[(size_t)pc] / frameMax;
+            }
+        }
+
+        return chroma;
+    }
+
+    // Pearson correlation between the chroma and a profile rotated to the given tonic
+    static double correlate(const std::array<double, 12>& chroma, const std::array<double, 12>& profile, int tonic)
+    {
+        double chromaMean = 0.0;
+        double profileMean = 0.0;
+
+        for (int i = 0; i < 12; ++i)
+        {
+            chromaMean += chroma[(size_t)i];
+            profileMean += profile[(size_t)i];
+        }
+
+        chromaMean /= 12.0;
+        profileMean /= 12.0;
+
+        double covariance = 0.0;
+        double chromaVariance = 0.0;
+        double profileVariance = 0.0;
+
+        for (int i = 0; i < 12; ++i)
+        {
+            double c = chroma[(size_t)((i + tonic) % 12)] - chromaMean;
+            double p = profile[(size_t)i] - profileMean;
+
+            covariance += c * p;
+            chromaVariance += c * c;
+            profileVariance += p * p;
+        }
+
+        if (chromaVariance <= 0.0 || profileVariance <= 0.0) return 0.0;
+
+        return covariance / std::sqrt(chromaVariance * profileVariance);
+    }
+};
\ No newline at end of file
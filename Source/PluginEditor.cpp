@@ -3,9 +3,9 @@
 
 AudioAnalyzerAudioProcessorEditor::AudioAnalyzerAudioProcessorEditor(AudioAnalyzerAudioProcessor& p) : AudioProcessorEditor(&p), audioProcessor(p)
 {
-    setSize(900, 700);
+    setSize(900, 900);
 
-    analysisThread = std::make_unique<AnalysisThread>(p, [this]() { analysisFinished(); });
+    analysisThread = std::make_unique<AnalysisThread>(p, [this]() { showPublishedResult(); });
 
     addAndMakeVisible(loadButton);
     loadButton.setButtonText("LOAD AUDIO FILE");
@@ -13,20 +13,16 @@ AudioAnalyzerAudioProcessorEditor::AudioAnalyzerAudioProcessorEditor(AudioAnalyz
     {
         fileChooser = std::make_unique<juce::FileChooser>("Select Audio File", juce::File{}, "*.aiff;*.flac;*.mp3;*.ogg;*.wav");
 
-        auto chooserFlags = juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles;
+        auto chooserFlags = juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles | juce::FileBrowserComponent::canSelectMultipleItems;
 
         fileChooser->launchAsync(chooserFlags, [this](const juce::FileChooser& chooser)
         {
-            auto file = chooser.getResult();
-
-            if (file.existsAsFile())
-            {
-                startAnalysis(file);
-            }
+            analyzeFiles(chooser.getResults());
         });
     };
 
     addAndMakeVisible(spectrumAnalyzer);
+    addChildComponent(spectrogramView);
 
     addAndMakeVisible(smoothingLabel);
     smoothingLabel.setText("SMOOTHING FACTOR:", juce::dontSendNotification);
@@ -42,23 +38,10 @@ AudioAnalyzerAudioProcessorEditor::AudioAnalyzerAudioProcessorEditor(AudioAnalyz
     smoothingCombo.addItem("1/3 OCT", 6);
     smoothingCombo.addItem("1/2 OCT", 7);
     smoothingCombo.addItem("1 OCT", 8);
+    // Items follow SpectrumAnalyzer::smoothingFactors, whose levels are all precomputed
     smoothingCombo.onChange = [this]
     {
-        float factor = 0.3f;
-
-        switch (smoothingCombo.getSelectedId())
-        {
-            case 1: factor = 0.0f;   break;
-            case 2: factor = 0.02f;  break;
-            case 3: factor = 0.04f;  break;
-            case 4: factor = 0.08f;  break;
-            case 5: factor = 0.15f;  break;
-            case 6: factor = 0.3f;   break;
-            case 7: factor = 0.5f;   break;
-            case 8: factor = 0.8f;   break;
-        }
-        
-        spectrumAnalyzer.setSmoothingOctave(factor);
+        spectrumAnalyzer.setSmoothingLevel(smoothingCombo.getSelectedItemIndex());
     };
     smoothingCombo.setSelectedId(6, juce::dontSendNotification);
 
@@ -83,6 +66,15 @@ AudioAnalyzerAudioProcessorEditor::AudioAnalyzerAudioProcessorEditor(AudioAnalyz
     setupToggle(btnShowSideMax, false, [&](bool b) {spectrumAnalyzer.settings.showSideMax = b;});
     setupToggle(btnShowStereoAvg, true, [&](bool b) {spectrumAnalyzer.settings.showStereoAvg = b;});
     setupToggle(btnShowStereoMax, true, [&](bool b) {spectrumAnalyzer.settings.showStereoMax = b;});
+    setupToggle(btnLoudestSection, false, [&](bool b) {batchQueue.setSpectrumLoudestSectionOnly(b);});
+    setupToggle(btnSpectrogram, false, [&](bool b)
+    {
+        spectrumAnalyzer.setVisible(!b);
+        spectrogramView.setVisible(b);
+
+        // Spectrograms are only captured while the view is on, so a result shown without one is analyzed again
+        if (b && singleFile != juce::File() && !singleFileHasSpectrogram && !btnLoudestSection.getToggleState()) startAnalysis(singleFile);
+    });
 
     auto setupLabel = [&](juce::Label& lbl, juce::String initText)
     {
@@ -104,11 +96,21 @@ AudioAnalyzerAudioProcessorEditor::AudioAnalyzerAudioProcessorEditor(AudioAnalyz
     setupLabel(loudnessRangeLabel, "LOUDNESS RANGE: Unknown");
     setupLabel(averageDynamicsPLRLabel, "AVERAGE DYNAMICS (PLR): Unknown");
     setupLabel(truePeakMaxDbLabel, "TRUE PEAK MAXIMUM dB: Unknown");
+    setupLabel(batchStatusLabel, "BATCH: Drop several files or a folder to analyze them in the background");
+
+    addAndMakeVisible(batchList);
+    batchList.setModel(this);
+    batchList.setRowHeight(22);
+    batchList.setColour(juce::ListBox::backgroundColourId, juce::Colour(0xff202221));
+    batchList.setColour(juce::ListBox::outlineColourId, juce::Colours::white.withAlpha(0.2f));
+    batchList.setOutlineThickness(1);
 }
 
 AudioAnalyzerAudioProcessorEditor::~AudioAnalyzerAudioProcessorEditor()
 {
-    if (analysisThread->isThreadRunning()) analysisThread->stopThread(2000);
+    // A cancelled graph skips its queued nodes, so this only waits for the running ones to reach their next block
+    analysisThread->cancelAnalysis();
+    analysisThread->waitForThreadToExit(-1);
 }
 
 void AudioAnalyzerAudioProcessorEditor::paint(juce::Graphics& g)
@@ -152,6 +154,7 @@ void AudioAnalyzerAudioProcessorEditor::resized()
     auto spectrumArea = area.removeFromTop(380);
 
     spectrumAnalyzer.setBounds(spectrumArea);
+    spectrogramView.setBounds(spectrumArea);
 
     area.removeFromTop(10);
 
@@ -160,6 +163,9 @@ void AudioAnalyzerAudioProcessorEditor::resized()
 
     smoothRow.removeFromLeft(150);
     smoothingCombo.setBounds(smoothRow.removeFromLeft(100));
+    smoothRow.removeFromLeft(30);
+    btnLoudestSection.setBounds(smoothRow.removeFromLeft(300));
+    btnSpectrogram.setBounds(smoothRow.removeFromLeft(150));
 
     area.removeFromTop(5);
 
@@ -181,114 +187,308 @@ void AudioAnalyzerAudioProcessorEditor::resized()
     btnShowSideMax.setBounds(row2.removeFromLeft(btnW));
     row2.removeFromLeft(btnW);
     btnShowStereoMax.setBounds(row2.removeFromLeft(btnW));
+
+    area.removeFromTop(10);
+
+    // Batch
+    batchStatusLabel.setBounds(area.removeFromTop(25));
+    batchList.setBounds(area);
 }
 
 void AudioAnalyzerAudioProcessorEditor::timerCallback()
 {
-    if (isAnalyzing)
-    {
-        loadingAnimationPos += 0.02f;
+    if (isAnalyzing) repaint();
 
-        if (loadingAnimationPos > 1.0f) loadingAnimationPos = 0.0f;
+    if (batchQueue.getChangeCount() != lastBatchChangeCount)
+    {
+        lastBatchChangeCount = batchQueue.getChangeCount();
 
-        repaint();
+        batchList.updateContent();
+        batchList.repaint();
+    }
+    else if (batchQueue.isBusy())
+    {
+        // Rows of files in flight show their live progress
+        batchList.repaint();
     }
+
+    updateBatchStatus();
+
+    if (!isAnalyzing && !batchQueue.isBusy()) stopTimer();
+}
+
+bool AudioAnalyzerAudioProcessorEditor::isSupportedAudioFile(const juce::File& file)
+{
+    return file.hasFileExtension("aiff;flac;mp3;ogg;wav");
 }
 
 bool AudioAnalyzerAudioProcessorEditor::isInterestedInFileDrag(const juce::StringArray& files)
 {
-    if (files.size() != 1) return false;
+    for (auto& path : files)
+    {
+        juce::File file(path);
 
-    auto ext = files[0].substring(files[0].lastIndexOf("."));
+        if (file.isDirectory() || isSupportedAudioFile(file)) return true;
+    }
 
-    return (ext.equalsIgnoreCase(".aiff") || ext.equalsIgnoreCase(".flac") || ext.equalsIgnoreCase(".mp3") || ext.equalsIgnoreCase(".ogg") || ext.equalsIgnoreCase(".wav"));
+    return false;
 }
 
 void AudioAnalyzerAudioProcessorEditor::filesDropped(const juce::StringArray& files, int x, int y)
 {
-    if (files.size() == 1)
+    juce::Array<juce::File> dropped;
+
+    for (auto& path : files)
     {
-        startAnalysis(juce::File(files[0]));
+        dropped.add(juce::File(path));
     }
+
+    analyzeFiles(dropped);
 }
 
 void AudioAnalyzerAudioProcessorEditor::paintOverChildren(juce::Graphics& g)
 {
     if (isAnalyzing)
     {
-        g.setColour(juce::Colours::black.withAlpha(0.7f));
-        g.fillAll();
+        // Only the spectrum is covered, and only until it arrives; the labels fill in underneath as stages finish
+        if (spectrumRequestId != analysisThread->getRequestId())
+        {
+            g.setColour(juce::Colours::black.withAlpha(0.7f));
+            g.fillRect(spectrumAnalyzer.getBounds());
+        }
 
-        auto center = getLocalBounds().getCentre();
-        int w = 220; int h = 70;
+        auto center = spectrumAnalyzer.getBounds().getCentre();
+        int w = 260; int h = 90;
         juce::Rectangle<float> box(center.x - w / 2, center.y - h / 2, w, h);
 
+        auto& progress = analysisThread->progress;
+        float fraction = progress.getOverallProgress();
+
         g.setColour(juce::Colour(0xff202221));
         g.fillRoundedRectangle(box, 12.0f);
         g.setColour(juce::Colours::white.withAlpha(0.2f));
         g.drawRoundedRectangle(box, 12.0f, 2.0f);
         g.setColour(juce::Colours::white);
         g.setFont(20.0f);
-        g.drawText("ANALYZING...", box.translated(0.0f, -10.0f), juce::Justification::centred);
-        g.setColour(juce::Colours::lightgreen);
+        g.drawText("ANALYZING... " + juce::String(juce::roundToInt(fraction * 100.0f)) + "%", box.translated(0.0f, -18.0f), juce::Justification::centred);
+        g.setColour(juce::Colours::white.withAlpha(0.6f));
+        g.setFont(13.0f);
+        g.drawText(AnalysisProgress::getStageName(progress.getCurrentStage()), box.translated(0.0f, 6.0f), juce::Justification::centred);
 
+        // Real progress, weighted across the decode, loudness, preparation and detection stages
         float barW = (float)(w - 40);
-        float x = box.getX() + 20 + (barW * loadingAnimationPos);
-        float width = barW * 0.2f;
 
-        if (x + width > box.getRight() - 20)
-        {
-            float part1 = (box.getRight() - 20) - x;
+        g.setColour(juce::Colours::white.withAlpha(0.1f));
+        g.fillRect(box.getX() + 20, box.getBottom() - 15, barW, 4.0f);
+        g.setColour(juce::Colours::lightgreen);
+        g.fillRect(box.getX() + 20, box.getBottom() - 15, barW * fraction, 4.0f);
+    }
+}
 
-            g.fillRect(x, box.getBottom() - 15, part1, 4.0f);
-            g.fillRect((float)(box.getX() + 20), box.getBottom() - 15, width - part1, 4.0f);
+// A single file is shown right away, superseding any analysis in progress; folders and multi-file selections go to the background batch queue
+void AudioAnalyzerAudioProcessorEditor::analyzeFiles(const juce::Array<juce::File>& files)
+{
+    juce::Array<juce::File> audioFiles;
+
+    for (auto& file : files)
+    {
+        if (file.isDirectory())
+        {
+            auto found = file.findChildFiles(juce::File::findFiles, true, "*.aiff;*.flac;*.mp3;*.ogg;*.wav");
+            found.sort();
+            audioFiles.addArray(found);
         }
-        else
+        else if (isSupportedAudioFile(file) && file.existsAsFile())
         {
-            g.fillRect(x, box.getBottom() - 15, width, 4.0f);
+            audioFiles.add(file);
         }
     }
+
+    if (audioFiles.isEmpty()) return;
+
+    if (audioFiles.size() == 1 && !files.getFirst().isDirectory())
+    {
+        startAnalysis(audioFiles.getFirst());
+
+        return;
+    }
+
+    batchQueue.addFiles(audioFiles);
+
+    startTimerHz(30);
 }
 
 void AudioAnalyzerAudioProcessorEditor::startAnalysis(juce::File file)
 {
-    if (isAnalyzing) return;
+    bool loudestSectionOnly = btnLoudestSection.getToggleState();
+    bool withSpectrogram = btnSpectrogram.getToggleState();
+
+    // Dropping the file that is already being analyzed, with the same options, is ignored and the running pass
+    // goes on; with other options the running pass is superseded
+    if (isAnalyzing && analysisThread->isRequested(file, loudestSectionOnly, withSpectrogram)) return;
+
+    singleFile = file;
+    singleFileHasSpectrogram = false;
 
     isAnalyzing = true;
+    selectionGeneration++;
     loadButton.setEnabled(false);
+    showResults({}, 0);
 
     startTimerHz(30);
     repaint();
 
-    analysisThread->startAnalysis(file);
+    analysisThread->startAnalysis(file, loudestSectionOnly, withSpectrogram);
 }
 
-void AudioAnalyzerAudioProcessorEditor::analysisFinished()
+// Called for every published snapshot, partial or final; each metric is shown as soon as its part arrives
+void AudioAnalyzerAudioProcessorEditor::showPublishedResult()
 {
-    stopTimer();
-
-    auto& data = audioProcessor.currentData;
-
-    durationLabel.setText("DURATION: " + data.getFormattedDuration(), juce::dontSendNotification);
-    bpmLabel.setText("BPM: " + juce::String(data.bpm), juce::dontSendNotification);
-    bpmConfidenceLabel.setText("BPM CONFIDENCE: %" + juce::String::formatted("%.2f", data.bpmConfidence), juce::dontSendNotification);
-    keyLabel.setText("KEY: " + data.musicalKey, juce::dontSendNotification);
-    keyConfidenceLabel.setText("KEY CONFIDENCE: %" + juce::String::formatted("%.2f", data.keyConfidence), juce::dontSendNotification);
-    camelotLabel.setText("CAMELOT: " + data.camelotKey, juce::dontSendNotification);
-    integratedLUFSLabel.setText("INTEGRATED LUFS: " + juce::String::formatted("%.2f", data.integratedLUFS), juce::dontSendNotification);
-    shortTermMaxLUFSLabel.setText("SHORT TERM MAXIMUM LUFS: " + juce::String::formatted("%.2f", data.shortTermMaxLUFS), juce::dontSendNotification);
-    momentaryMaxLUFSLabel.setText("MOMENTARY MAXIMUM LUFS: " + juce::String::formatted("%.2f", data.momentaryMaxLUFS), juce::dontSendNotification);
-    loudnessRangeLabel.setText("LOUDNESS RANGE: " + juce::String::formatted("%.2f", data.loudnessRange), juce::dontSendNotification);
-    averageDynamicsPLRLabel.setText("AVERAGE DYNAMICS (PLR): " + juce::String::formatted("%.2f", data.averageDynamicsPLR), juce::dontSendNotification);
-    truePeakMaxDbLabel.setText("TRUE PEAK MAXIMUM dB: " + juce::String::formatted("%.2f", data.truePeakMax), juce::dontSendNotification);
-
-    if (analysisThread->spectrumBuffer.getNumSamples() > 0 && analysisThread->sampleRate > 0)
+    auto snapshot = analysisThread->collectResult();
+
+    if (snapshot == nullptr || snapshot->requestId != analysisThread->getRequestId()) return;
+
+    auto& data = snapshot->data;
+
+    if (snapshot->failed)
+    {
+        showResults(data, 0, "-");
+        durationLabel.setText("DURATION: Could not read " + snapshot->file.getFileName(), juce::dontSendNotification);
+    }
+    else
     {
-        spectrumAnalyzer.analyzeBuffer(analysisThread->spectrumBuffer, analysisThread->sampleRate);
+        showResults(data, snapshot->parts);
     }
 
+    // The spectrum arrives already computed; only its smoothing runs, on the worker pool
+    if (snapshot->hasPart(AnalysisEngine::spectrumPart) && snapshot->spectrum != nullptr && spectrumRequestId != snapshot->requestId)
+    {
+        spectrumRequestId = snapshot->requestId;
+        spectrumAnalyzer.setSpectrumData(snapshot->spectrum);
+        spectrogramView.setSpectrogram(snapshot->spectrum->spectrogram);
+        singleFileHasSpectrogram = snapshot->spectrum->spectrogram != nullptr;
+    }
+
+    if (!snapshot->isComplete) return;
+
+    if (!data.loadedFromCache) analysisThread->storeInCache(*snapshot);
+
     isAnalyzing = false;
     loadButton.setEnabled(true);
 
+    if (!batchQueue.isBusy()) stopTimer();
+
     repaint();
 }
+
+// Labels of parts that have not arrived yet show missingText
+void AudioAnalyzerAudioProcessorEditor::showResults(const TrackAnalysisData& data, int parts, const juce::String& missingText)
+{
+    auto show = [parts, &missingText](juce::Label& label, const juce::String& name, int part, const juce::String& value)
+    {
+        label.setText(name + ((parts & part) != 0 ? value : missingText), juce::dontSendNotification);
+    };
+
+    show(durationLabel, "DURATION: ", AnalysisEngine::loudnessPart, data.getFormattedDuration());
+    show(bpmLabel, "BPM: ", AnalysisEngine::bpmPart, juce::String(data.bpm));
+    show(bpmConfidenceLabel, "BPM CONFIDENCE: ", AnalysisEngine::bpmPart, "%" + juce::String::formatted("%.2f", data.bpmConfidence));
+    show(keyLabel, "KEY: ", AnalysisEngine::keyPart, data.musicalKey);
+    show(keyConfidenceLabel, "KEY CONFIDENCE: ", AnalysisEngine::keyPart, "%" + juce::String::formatted("%.2f", data.keyConfidence));
+    show(camelotLabel, "CAMELOT: ", AnalysisEngine::keyPart, data.camelotKey);
+    show(integratedLUFSLabel, "INTEGRATED LUFS: ", AnalysisEngine::loudnessPart, juce::String::formatted("%.2f", data.integratedLUFS));
+    show(shortTermMaxLUFSLabel, "SHORT TERM MAXIMUM LUFS: ", AnalysisEngine::loudnessPart, juce::String::formatted("%.2f", data.shortTermMaxLUFS));
+    show(momentaryMaxLUFSLabel, "MOMENTARY MAXIMUM LUFS: ", AnalysisEngine::loudnessPart, juce::String::formatted("%.2f", data.momentaryMaxLUFS));
+    show(loudnessRangeLabel, "LOUDNESS RANGE: ", AnalysisEngine::loudnessPart, juce::String::formatted("%.2f", data.loudnessRange));
+    show(averageDynamicsPLRLabel, "AVERAGE DYNAMICS (PLR): ", AnalysisEngine::loudnessPart, juce::String::formatted("%.2f", data.averageDynamicsPLR));
+    show(truePeakMaxDbLabel, "TRUE PEAK MAXIMUM dB: ", AnalysisEngine::loudnessPart, juce::String::formatted("%.2f", data.truePeakMax));
+}
+
+void AudioAnalyzerAudioProcessorEditor::updateBatchStatus()
+{
+    auto progress = batchQueue.getProgress();
+
+    if (progress.numItems == 0) return;
+
+    juce::String text;
+
+    text << "BATCH: " << (progress.numFinished + progress.numFailed) << " / " << progress.numItems << " ANALYZED";
+
+    if (progress.numFailed > 0) text << ", " << progress.numFailed << " FAILED";
+
+    if (progress.numAnalyzing > 0) text << ", " << progress.numAnalyzing << " RUNNING";
+
+    text << " - " << juce::String::formatted("%.1f", progress.tracksPerMinute) << " TRACKS/MIN";
+
+    batchStatusLabel.setText(text, juce::dontSendNotification);
+}
+
+int AudioAnalyzerAudioProcessorEditor::getNumRows()
+{
+    return batchQueue.getNumItems();
+}
+
+void AudioAnalyzerAudioProcessorEditor::paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected)
+{
+    auto item = batchQueue.getItem(rowNumber);
+
+    if (item.file == juce::File()) return;
+
+    if (rowIsSelected) g.fillAll(juce::Colours::lightgreen.withAlpha(0.2f));
+
+    auto area = juce::Rectangle<int>(0, 0, width, height).reduced(6, 0);
+    bool hasResults = item.status == BatchAnalysisQueue::Status::done || item.status == BatchAnalysisQueue::Status::cached;
+
+    g.setFont(14.0f);
+    g.setColour(item.status == BatchAnalysisQueue::Status::failed ? juce::Colours::indianred : juce::Colours::white);
+    juce::String statusText = BatchAnalysisQueue::getStatusText(item.status);
+
+    if (item.status == BatchAnalysisQueue::Status::analyzing) statusText << " " << juce::roundToInt(item.progress * 100.0f) << "%";
+
+    g.drawText(statusText, area.removeFromRight(110), juce::Justification::centredRight);
+
+    if (hasResults)
+    {
+        g.setColour(juce::Colours::white.withAlpha(0.7f));
+        g.drawText(juce::String::formatted("%.2f LUFS", item.data.integratedLUFS), area.removeFromRight(100), juce::Justification::centredRight);
+        g.drawText(item.data.camelotKey, area.removeFromRight(50), juce::Justification::centredRight);
+        g.drawText(juce::String(item.data.bpm) + " BPM", area.removeFromRight(90), juce::Justification::centredRight);
+    }
+
+    g.setColour(juce::Colours::white);
+    g.drawText(item.file.getFileName(), area, juce::Justification::centredLeft, true);
+}
+
+// Finished batch rows can be inspected; their spectrum comes back from the result cache, read on the shared pool
+void AudioAnalyzerAudioProcessorEditor::selectedRowsChanged(int lastRowSelected)
+{
+    if (isAnalyzing) return;
+
+    auto item = batchQueue.getItem(lastRowSelected);
+
+    if (item.cacheKey.isEmpty()) return;
+
+    showResults(item.data);
+    singleFile = juce::File();
+
+    int jobGeneration = ++selectionGeneration;
+    juce::Component::SafePointer<AudioAnalyzerAudioProcessorEditor> safeThis(this);
+
+    pool->submit([safeThis, jobGeneration, key = item.cacheKey]
+    {
+        TrackAnalysisData cachedData;
+        SpectrumData cachedSpectrum;
+
+        if (!AnalysisCache(AnalysisEngine::settingsVersion).load(key, cachedData, cachedSpectrum)) return;
+
+        auto spectrum = std::make_shared<const SpectrumData>(std::move(cachedSpectrum));
+
+        // Dropped if another row was selected or an analysis started in the meantime
+        juce::MessageManager::callAsync([safeThis, jobGeneration, spectrum]
+        {
+            if (safeThis == nullptr || jobGeneration != safeThis->selectionGeneration) return;
+
+            safeThis->spectrumAnalyzer.setSpectrumData(spectrum);
+            safeThis->spectrogramView.setSpectrogram(spectrum->spectrogram);
+        });
+    });
+}
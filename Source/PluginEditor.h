@@ -1,6 +1,10 @@
 #pragma once
 
+#include "AnalysisCache.h"
+#include "AnalysisSnapshot.h"
+#include "BatchAnalysisQueue.h"
 #include "PluginProcessor.h"
+#include "SpectrogramView.h"
 #include "SpectrumAnalyzer.h"
 #include <JuceHeader.h>
 
@@ -8,50 +12,206 @@ class AnalysisThread : public juce::Thread
 {
 public:
 
-    AnalysisThread(AudioAnalyzerAudioProcessor& p, std::function<void()> onFinished) : Thread("AnalysisThread"), processor(p), onFinishedCallback(onFinished)
+    AnalysisThread(AudioAnalyzerAudioProcessor& p, std::function<void()> onResult) : Thread("AnalysisThread"), processor(p), onResultCallback(onResult)
     {
     }
 
-    void startAnalysis(juce::File f)
+    // A new request supersedes the running one without waiting for it: the running analysis is cancelled and
+    // drains on the analysis thread, which then starts the newest request
+    void startAnalysis(juce::File f, bool loudestSectionOnly, bool withSpectrogram)
     {
-        fileToAnalyze = f;
+        {
+            std::lock_guard<std::mutex> lock(requestMutex);
+
+            fileToAnalyze = f;
+            spectrumLoudestSectionOnly = loudestSectionOnly;
+            captureSpectrogram = withSpectrogram;
+            requestId++;
+            progress.cancel();
+        }
+
+        if (!isThreadRunning()) startThread();
+
+        notify();
+    }
+
+    // True if the newest request is for this file with these options; only the message thread makes requests
+    bool isRequested(const juce::File& f, bool loudestSectionOnly, bool withSpectrogram)
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+
+        return fileToAnalyze == f && spectrumLoudestSectionOnly == loudestSectionOnly && captureSpectrogram == withSpectrogram;
+    }
 
-        startThread();
+    int getRequestId() const { return requestId.load(); }
+
+    // Message thread only: the newest published result, or nullptr if nothing new has arrived
+    std::unique_ptr<const AnalysisSnapshot> collectResult() { return results.collect(); }
+
+    // Stops the running analysis at its next block boundary, kills any external tool it started and ends the thread
+    void cancelAnalysis()
+    {
+        {
+            std::lock_guard<std::mutex> lock(requestMutex);
+
+            progress.cancel();
+        }
+
+        signalThreadShouldExit();
+        notify();
     }
 
     void run() override
+    {
+        while (!threadShouldExit())
+        {
+            juce::File file;
+            bool loudestSectionOnly = false;
+            bool withSpectrogram = false;
+            int id = 0;
+
+            {
+                std::lock_guard<std::mutex> lock(requestMutex);
+
+                if (requestId.load() != startedRequestId)
+                {
+                    file = fileToAnalyze;
+                    loudestSectionOnly = spectrumLoudestSectionOnly;
+                    withSpectrogram = captureSpectrogram;
+                    id = startedRequestId = requestId.load();
+
+                    // Under the lock, so it never races with the cancellation of a newer request
+                    progress.reset();
+                }
+            }
+
+            if (id == 0) wait(-1);
+            else analyze(file, loudestSectionOnly, withSpectrogram, id);
+        }
+    }
+
+    void analyze(const juce::File& file, bool loudestSectionOnly, bool withSpectrogram, int id)
     {
         double totalStart = juce::Time::getMillisecondCounterHiRes();
 
-        processor.analyzeLoadedFile(fileToAnalyze);
+        // Set between runs only, so no analysis is using the engine while it changes. A spectrogram is recorded
+        // only when the view asks for one; batch and command-line runs use engines of their own
+        processor.analyzer.spectrumLoudestSectionOnly = loudestSectionOnly;
+        processor.analyzer.captureSpectrogram = withSpectrogram;
+
+        // Filled here only, then handed to the message thread as a whole
+        auto snapshot = std::make_unique<AnalysisSnapshot>();
+        snapshot->requestId = id;
+        snapshot->file = file;
+        snapshot->cacheKey = cache.makeKey(file, processor.analyzer.getCacheVariant());
+
+        SpectrumData cachedSpectrum;
+
+        // An entry without a spectrogram is a miss only when one was requested; the file is analyzed again and
+        // the entry replaced
+        if (cache.load(snapshot->cacheKey, snapshot->data, cachedSpectrum)
+            && (cachedSpectrum.spectrogram != nullptr || !processor.analyzer.capturesSpectrogram()))
+        {
+            snapshot->data.timeCacheLookup = juce::Time::getMillisecondCounterHiRes() - totalStart;
+            snapshot->spectrum = std::make_shared<const SpectrumData>(std::move(cachedSpectrum));
+        }
+        else
+        {
+            double lookupTime = juce::Time::getMillisecondCounterHiRes() - totalStart;
+            SpectrumData spectrum;
+
+            // Every finished stage publishes a partial snapshot holding all parts finished so far
+            std::mutex partialMutex;
+            TrackAnalysisData partialData;
+            int partialParts = 0;
+            std::shared_ptr<const SpectrumData> sharedSpectrum;
+
+            auto publishPartial = [&](AnalysisEngine::ResultPart part, const TrackAnalysisData& data)
+            {
+                std::lock_guard<std::mutex> lock(partialMutex);
+
+                AnalysisEngine::mergeResultPart(partialData, part, data);
+                partialParts |= part;
 
-        double specStart = juce::Time::getMillisecondCounterHiRes();
+                auto partial = std::make_unique<AnalysisSnapshot>();
+                partial->requestId = id;
+                partial->file = file;
+                partial->cacheKey = snapshot->cacheKey;
+                partial->data = partialData;
+                partial->parts = partialParts;
 
-        prepareSpectrumBuffer();
+                // The engine is done with the spectrum once its part is reported, so it moves into shared storage once
+                if (part == AnalysisEngine::spectrumPart) sharedSpectrum = std::make_shared<const SpectrumData>(std::move(spectrum));
 
-        double specEnd = juce::Time::getMillisecondCounterHiRes();
+                partial->spectrum = sharedSpectrum;
 
-        processor.currentData.timeSpectrumCalc = specEnd - specStart;
-        processor.currentData.timeTotal = juce::Time::getMillisecondCounterHiRes() - totalStart;
+                publish(std::move(partial));
+            };
 
-        writeLogFile(processor.currentData); // Save Time Log File (Optional)
+            snapshot->data = processor.analyzeLoadedFile(file, &spectrum, &progress, publishPartial);
 
-        juce::MessageManager::callAsync([this]()
+            if (progress.isCancelled() || threadShouldExit()) return;
+
+            snapshot->data.timeCacheLookup = lookupTime;
+            snapshot->spectrum = sharedSpectrum;
+        }
+
+        snapshot->data.timeTotal = juce::Time::getMillisecondCounterHiRes() - totalStart;
+        snapshot->failed = snapshot->data.sampleRate <= 0;
+        snapshot->parts = snapshot->failed ? 0 : AnalysisEngine::allParts;
+        snapshot->isComplete = true;
+
+        writeLogFile(file, snapshot->data); // Save Time Log File (Optional)
+
+        publish(std::move(snapshot));
+    }
+
+    // Called with the final snapshot of a freshly analyzed file; the entry is written on the shared pool
+    void storeInCache(const AnalysisSnapshot& snapshot)
+    {
+        if (snapshot.data.loadedFromCache || snapshot.cacheKey.isEmpty() || snapshot.spectrum == nullptr) return;
+
+        pool->submit([key = snapshot.cacheKey, data = snapshot.data, spectrum = snapshot.spectrum]()
         {
-            if (onFinishedCallback) onFinishedCallback();
+            AnalysisCache(AnalysisEngine::settingsVersion).store(key, data, *spectrum, true);
         });
     }
 
-    juce::AudioBuffer<float> spectrumBuffer;
-    double sampleRate = 0.0;
+    AnalysisProgress progress;
 
 private:
 
     AudioAnalyzerAudioProcessor& processor;
     juce::File fileToAnalyze;
-    std::function<void()> onFinishedCallback;
+    bool spectrumLoudestSectionOnly = false;
+    bool captureSpectrogram = false;
+    std::atomic<int> requestId { 0 };
+    int startedRequestId = 0;
+    std::mutex requestMutex;
+    std::function<void()> onResultCallback;
+    AnalysisCache cache { AnalysisEngine::settingsVersion };
+    SnapshotMailbox<AnalysisSnapshot> results;
+    juce::SharedResourcePointer<AnalysisThreadPool> pool;
+
+    // Released on the message thread together with this object, so a pending callback can check it there
+    std::shared_ptr<bool> aliveToken = std::make_shared<bool>(true);
+
+    void publish(std::unique_ptr<AnalysisSnapshot> snapshot)
+    {
+        int id = snapshot->requestId;
 
-    void writeLogFile(const TrackAnalysisData& data)
+        results.publish(std::move(snapshot));
+
+        // A result that arrives after a newer request has started, or after this thread is gone, is dropped
+        juce::MessageManager::callAsync([this, id, token = std::weak_ptr<bool>(aliveToken)]()
+        {
+            if (token.expired()) return;
+
+            if (id == requestId.load() && onResultCallback) onResultCallback();
+        });
+    }
+
+    void writeLogFile(const juce::File& file, const TrackAnalysisData& data)
     {
         juce::File analyzerDir = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory).getChildFile("AudioAnalyzer");
 
@@ -65,9 +225,19 @@ private:
         juce::String logEntry;
 
         logEntry << "/--------------------------------------------------\n\n";
-        logEntry << "FILE NAME: " << fileToAnalyze.getFileName() << "\n";
+        logEntry << "FILE NAME: " << file.getFileName() << "\n";
         logEntry << "ANALYSIS DATE: " << juce::Time::getCurrentTime().toString(true, true) << "\n\n";
-        logEntry << "1. AUDIO LOADING TIME: " << juce::String(data.timeAudioLoading, 2) << " ms\n";
+        logEntry << "0. RESULT CACHE: " << (data.loadedFromCache ? "HIT" : "MISS") << " (lookup " << juce::String(data.timeCacheLookup, 2) << " ms)\n";
+        logEntry << "1. AUDIO DECODING TIME: " << juce::String(data.timeAudioLoading, 2) << " ms\n";
+        logEntry << "   - Memory-Mapped Reader: " << (data.usedMemoryMappedReader ? "Yes" : "No") << "\n";
+
+        if (data.usedMemoryMappedReader)
+        {
+            logEntry << "   - Mapping Time: " << juce::String(data.timeMemoryMapping, 2) << " ms\n";
+            logEntry << "   - Read From Mapping (stream copy avoided): " << juce::String(data.bytesReadFromMapping / (1024.0 * 1024.0), 2) << " MB\n";
+        }
+
+        logEntry << "   - Reused Block Buffers (allocation avoided): " << juce::String(data.reusedBlockBytes / (1024.0 * 1024.0), 2) << " MB\n";
         logEntry << "2. LOUDNESS ANALYSIS TIME: " << juce::String(data.timeLoudnessAnalysis, 2) << " ms\n";
         logEntry << "3. BPM ANALYSIS TIME:\n";
         logEntry << "   - Preparation Time: " << juce::String(data.timeBpmPrep, 2) << " ms\n";
@@ -83,49 +253,10 @@ private:
 
         logFile.appendText(logEntry);
     }
-
-    void prepareSpectrumBuffer()
-    {
-        juce::AudioFormatManager formatManager;
-        formatManager.registerBasicFormats();
-        std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(fileToAnalyze));
-
-        if (reader != nullptr)
-        {
-            sampleRate = reader->sampleRate;
-            double targetDuration = 30.0;
-            int windowSize = (int)(targetDuration * sampleRate);
-
-            if (windowSize > reader->lengthInSamples) windowSize = (int)reader->lengthInSamples;
-
-            int stepSize = (int)sampleRate;
-            int numChannels = reader->numChannels;
-            int64_t bestStartSample = 0;
-            double maxRMS = -1.0;
-            juce::AudioBuffer<float> scanBuffer(numChannels, stepSize);
-
-            for (int64_t i = 0; i < reader->lengthInSamples - windowSize; i += stepSize * 5)
-            {
-                reader->read(&scanBuffer, 0, stepSize, i, true, true);
-                double currentRMS = scanBuffer.getRMSLevel(0, 0, stepSize);
-
-                if (numChannels > 1) currentRMS = (currentRMS + scanBuffer.getRMSLevel(1, 0, stepSize)) * 0.5;
-
-                if (currentRMS > maxRMS)
-                {
-                    maxRMS = currentRMS;
-                    bestStartSample = i;
-                }
-            }
-
-            spectrumBuffer.setSize(numChannels, windowSize);
-            reader->read(&spectrumBuffer, 0, windowSize, bestStartSample, true, true);
-        }
-    }
 };
 
 class AudioAnalyzerAudioProcessorEditor : public juce::AudioProcessorEditor,
-    public juce::FileDragAndDropTarget, public juce::Timer
+    public juce::FileDragAndDropTarget, public juce::Timer, public juce::ListBoxModel
 {
 public:
     AudioAnalyzerAudioProcessorEditor(AudioAnalyzerAudioProcessor&);
@@ -139,18 +270,36 @@ public:
     void filesDropped(const juce::StringArray& files, int x, int y) override;
     void paintOverChildren(juce::Graphics&) override;
 
+    int getNumRows() override;
+    void paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected) override;
+    void selectedRowsChanged(int lastRowSelected) override;
+
 private:
 
+    static bool isSupportedAudioFile(const juce::File& file);
+
+    void analyzeFiles(const juce::Array<juce::File>& files);
     void startAnalysis(juce::File file);
-    void analysisFinished();
+    void showPublishedResult();
+    void showResults(const TrackAnalysisData& data, int parts = AnalysisEngine::allParts, const juce::String& missingText = "...");
+    void updateBatchStatus();
 
     bool isAnalyzing = false;
-    float loadingAnimationPos = 0.0f;
+    int spectrumRequestId = -1;
+    int selectionGeneration = 0;
+
+    // The last single file analyzed, so turning the spectrogram on can analyze it again with one
+    juce::File singleFile;
+    bool singleFileHasSpectrogram = false;
 
     AudioAnalyzerAudioProcessor& audioProcessor;
     SpectrumAnalyzer spectrumAnalyzer;
+    SpectrogramView spectrogramView;
 
     std::unique_ptr<AnalysisThread> analysisThread;
+    BatchAnalysisQueue batchQueue;
+    juce::SharedResourcePointer<AnalysisThreadPool> pool;
+    int lastBatchChangeCount = -1;
     juce::TextButton loadButton{"LOAD AUDIO FILE"};
     std::unique_ptr<juce::FileChooser> fileChooser;
 
@@ -161,6 +310,8 @@ private:
     juce::ToggleButton btnShowSideMax{"SIDE MAXIMUM"};
     juce::ToggleButton btnShowStereoAvg{"TOTAL AVERAGE"};
     juce::ToggleButton btnShowStereoMax{"TOTAL MAXIMUM"};
+    juce::ToggleButton btnLoudestSection{"SPECTRUM OF LOUDEST 20 S ONLY"};
+    juce::ToggleButton btnSpectrogram{"SPECTROGRAM"};
 
     // ComboBox
     juce::ComboBox smoothingCombo;
@@ -180,5 +331,9 @@ private:
     juce::Label averageDynamicsPLRLabel;
     juce::Label truePeakMaxDbLabel;
 
+    // Batch
+    juce::Label batchStatusLabel;
+    juce::ListBox batchList;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioAnalyzerAudioProcessorEditor)
 };
\ No newline at end of file
@@ -57,11 +57,12 @@ public:
     void setStateInformation(const void* data, int sizeInBytes) override;
 
     AnalysisEngine analyzer;
-    TrackAnalysisData currentData;
 
-    void analyzeLoadedFile(juce::File file)
+    // Results go back to the caller, which publishes them to the UI as an immutable snapshot
+    TrackAnalysisData analyzeLoadedFile(juce::File file, SpectrumData* spectrum = nullptr, AnalysisProgress* progress = nullptr,
+                                        AnalysisEngine::PartialResultCallback onPartialResult = nullptr)
     {
-        currentData = analyzer.analyzeFile(file);
+        return analyzer.analyzeFile(file, spectrum, progress, onPartialResult);
     }
 
 private:
@@ -0,0 +1,316 @@
+#pragma once
+
+#include "AnalysisProgress.h"
+#include "AnalysisThreadPool.h"
+#include <JuceHeader.h>
+#include <deque>
+#include <mutex>
+
+class AudioBlockConsumer
+{
+public:
+
+    virtual ~AudioBlockConsumer() = default;
+
+    virtual void prepare(int numChannels, double sampleRate, juce::int64 lengthInSamples) = 0;
+    virtual void processBlock(const juce::AudioBuffer<float>& block, int numSamples) = 0;
+    virtual void finish() {}
+
+    double processingTime = 0.0;
+
+    // The slot this consumer's block progress is reported to; numStages means it is not reported
+    AnalysisProgress::Stage progressStage = AnalysisProgress::numStages;
+};
+
+class SharedAudioSource
+{
+public:
+
+    SharedAudioSource()
+    {
+        formatManager.registerBasicFormats();
+    }
+
+    bool open(juce::File audioFile)
+    {
+        reader = openMemoryMappedReader(audioFile);
+
+        if (reader == nullptr) reader = std::unique_ptr<juce::AudioFormatReader>(formatManager.createReaderFor(audioFile));
+
+        return reader != nullptr;
+    }
+
+    int getNumChannels() const { return reader != nullptr ? (int)reader->numChannels : 0; }
+    double getSampleRate() const { return reader != nullptr ? reader->sampleRate : 0.0; }
+    juce::int64 getLengthInSamples() const { return reader != nullptr ? reader->lengthInSamples : 0; }
+
+    bool isMemoryMapped() const { return memoryMapped; }
+    double getMappingTime() const { return mappingTime; }
+    juce::int64 getBytesReadFromMapping() const { return bytesReadFromMapping; }
+    juce::int64 getReusedBlockBytes() const { return reusedBlockBytes; }
+
+    // Decodes the file once and fans every block out to all consumers. Each consumer processes its blocks in
+    // order on whichever shared pool worker is free; the calling thread decodes, and if it is a pool worker
+    // itself it helps with this source's blocks while it waits.
+    // Cancellation is checked between blocks; a cancelled run drops queued blocks and skips finish().
+    // Returns the time spent decoding.
+    double run(const std::vector<AudioBlockConsumer*>& consumers, AnalysisProgress* progress = nullptr)
+    {
+        if (reader == nullptr) return 0.0;
+
+        const int numChannels = getNumChannels();
+        const juce::int64 lengthInSamples = getLengthInSamples();
+
+        for (auto* consumer : consumers)
+        {
+            consumer->prepare(numChannels, getSampleRate(), lengthInSamples);
+        }
+
+        std::vector<std::unique_ptr<ConsumerStrand>> strands;
+
+        for (auto* consumer : consumers)
+        {
+            strands.push_back(std::make_unique<ConsumerStrand>(consumer, progress, lengthInSamples));
+        }
+
+        auto noStrandIsFull = [&strands]
+        {
+            for (auto& strand : strands)
+            {
+                if (strand->getNumPending() >= maxQueuedBlocks) return false;
+            }
+
+            return true;
+        };
+
+        double decodeTime = 0.0;
+        juce::int64 position = 0;
+
+        while (position < lengthInSamples)
+        {
+            if (progress != nullptr && progress->isCancelled()) break;
+
+            // Bounded look-ahead: decoding waits while any consumer is too far behind
+            pool->waitUntil(noStrandIsFull, this);
+
+            int numSamples = (int)std::min((juce::int64)blockSize, lengthInSamples - position);
+            auto block = acquireBlock(numChannels);
+            block->numSamples = numSamples;
+
+            double tStart = juce::Time::getMillisecondCounterHiRes();
+
+            // For mapped files this converts straight from the mapping into the pooled block
+            reader->read(&block->buffer, 0, numSamples, position, true, true);
+
+            decodeTime += juce::Time::getMillisecondCounterHiRes() - tStart;
+
+            if (memoryMapped) bytesReadFromMapping += (juce::int64)numSamples * numChannels * (reader->bitsPerSample / 8);
+
+            for (auto& strand : strands)
+            {
+                strand->push(block, *pool, this);
+            }
+
+            position += numSamples;
+
+            if (progress != nullptr) progress->setStageProgress(AnalysisProgress::decoding, (float)position / (float)lengthInSamples);
+        }
+
+        pool->waitUntil([&strands]
+        {
+            for (auto& strand : strands)
+            {
+                if (!strand->isIdle()) return false;
+            }
+
+            return true;
+        }, this);
+
+        if (progress != nullptr && progress->isCancelled()) return decodeTime;
+
+        AnalysisTaskGraph finishGraph(*pool);
+
+        for (auto* consumer : consumers)
+        {
+            finishGraph.add([consumer]
+            {
+                double tStart = juce::Time::getMillisecondCounterHiRes();
+
+                consumer->finish();
+
+                consumer->processingTime += juce::Time::getMillisecondCounterHiRes() - tStart;
+            });
+        }
+
+        finishGraph.run();
+
+        return decodeTime;
+    }
+
+private:
+
+    struct Block
+    {
+        juce::AudioBuffer<float> buffer;
+        int numSamples = 0;
+    };
+
+    using BlockPtr = std::shared_ptr<const Block>;
+
+    // Blocks go back to a small pool once every consumer has released them, so decoding does not
+    // allocate per block; the pool never holds more than the queues can keep in flight
+    std::shared_ptr<Block> acquireBlock(int numChannels)
+    {
+        std::unique_ptr<Block> block;
+
+        {
+            std::lock_guard<std::mutex> lock(poolMutex);
+
+            if (!freeBlocks.empty())
+            {
+                block = std::move(freeBlocks.back());
+                freeBlocks.pop_back();
+                reusedBlockBytes += (juce::int64)block->buffer.getNumChannels() * block->buffer.getNumSamples() * (juce::int64)sizeof(float);
+            }
+        }
+
+        if (block == nullptr)
+        {
+            block = std::make_unique<Block>();
+            block->buffer.setSize(numChannels, blockSize);
+        }
+
+        return std::shared_ptr<Block>(block.release(), [this](Block* b)
+        {
+            std::lock_guard<std::mutex> lock(poolMutex);
+            freeBlocks.push_back(std::unique_ptr<Block>(b));
+        });
+    }
+
+    std::unique_ptr<juce::AudioFormatReader> openMemoryMappedReader(juce::File audioFile)
+    {
+        memoryMapped = false;
+        mappingTime = 0.0;
+        bytesReadFromMapping = 0;
+        reusedBlockBytes = 0;
+
+        std::unique_ptr<juce::MemoryMappedAudioFormatReader> mappedReader;
+
+        if (audioFile.hasFileExtension("wav"))
+        {
+            juce::WavAudioFormat wavFormat;
+            mappedReader.reset(wavFormat.createMemoryMappedReader(audioFile));
+        }
+        else if (audioFile.hasFileExtension("aif;aiff"))
+        {
+            juce::AiffAudioFormat aiffFormat;
+            mappedReader.reset(aiffFormat.createMemoryMappedReader(audioFile));
+        }
+
+        if (mappedReader == nullptr) return nullptr;
+
+        double tStart = juce::Time::getMillisecondCounterHiRes();
+
+        if (!mappedReader->mapEntireFile()) return nullptr;
+
+        mappingTime = juce::Time::getMillisecondCounterHiRes() - tStart;
+        memoryMapped = true;
+
+        return std::unique_ptr<juce::AudioFormatReader>(mappedReader.release());
+    }
+
+    // Hands one consumer's blocks to the pool strictly in order: at most one drain task is queued or running
+    // per consumer, and it keeps processing until the consumer has caught up
+    class ConsumerStrand
+    {
+    public:
+
+        ConsumerStrand(AudioBlockConsumer* c, AnalysisProgress* p, juce::int64 length) : consumer(c), progress(p), lengthInSamples(length) {}
+
+        void push(BlockPtr block, AnalysisThreadPool& pool, const void* group)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            pending.push_back(std::move(block));
+
+            if (scheduled) return;
+
+            scheduled = true;
+            pool.submit([this] { drain(); }, group);
+        }
+
+        size_t getNumPending()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            return pending.size();
+        }
+
+        bool isIdle()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            return pending.empty() && !scheduled;
+        }
+
+    private:
+
+        void drain()
+        {
+            for (;;)
+            {
+                BlockPtr block;
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    if (progress != nullptr && progress->isCancelled()) pending.clear();
+
+                    if (pending.empty())
+                    {
+                        scheduled = false;
+
+                        return;
+                    }
+
+                    block = std::move(pending.front());
+                    pending.pop_front();
+                }
+
+                double tStart = juce::Time::getMillisecondCounterHiRes();
+
+                consumer->processBlock(block->buffer, block->numSamples);
+
+                consumer->processingTime += juce::Time::getMillisecondCounterHiRes() - tStart;
+                samplesProcessed += block->numSamples;
+
+                if (progress != nullptr && consumer->progressStage != AnalysisProgress::numStages)
+                {
+                    progress->setStageProgress(consumer->progressStage, (float)samplesProcessed / (float)lengthInSamples);
+                }
+            }
+        }
+
+        AudioBlockConsumer* consumer;
+        AnalysisProgress* progress;
+        juce::int64 lengthInSamples;
+        juce::int64 samplesProcessed = 0;
+        std::mutex mutex;
+        std::deque<BlockPtr> pending;
+        bool scheduled = false;
+    };
+
+    static constexpr size_t maxQueuedBlocks = 8;
+    static constexpr int blockSize = 32768;
+
+    juce::SharedResourcePointer<AnalysisThreadPool> pool;
+    juce::AudioFormatManager formatManager;
+    std::unique_ptr<juce::AudioFormatReader> reader;
+    bool memoryMapped = false;
+    double mappingTime = 0.0;
+    juce::int64 bytesReadFromMapping = 0;
+    juce::int64 reusedBlockBytes = 0;
+
+    std::mutex poolMutex;
+    std::vector<std::unique_ptr<Block>> freeBlocks;
+};
\ No newline at end of file
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "TrackAnalysisData.h"
+#include <JuceHeader.h>
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+
+// Multi-resolution image cache of a spectrogram. Level 0 is one column per STFT frame; every further level
+// halves the column count by keeping the louder of two neighbours, so a short resonance still shows when
+// zoomed out. Each level is cut into fixed-width tiles that are coloured on first use and kept in a small
+// least-recently-used set, so zooming and panning only draws images and never touches an FFT.
+// The levels can be built on any thread; tiles are rendered on the message thread only.
+class SpectrogramTileCache
+{
+public:
+
+    static constexpr int tileWidth = 256;
+    static constexpr int maxCachedTiles = 64;
+
+    explicit SpectrogramTileCache(std::shared_ptr<const SpectrogramData> source) : data(std::move(source))
+    {
+        const int numBands = SpectrogramData::numBands;
+
+        numColumns.push_back(data->numColumns);
+
+        // Levels stop once the whole track fits in one tile
+        while (numColumns.back() > tileWidth)
+        {
+            const juce::uint8* previous = getLevelData(getNumLevels() - 1);
+            int previousColumns = numColumns.back();
+            int columns = (previousColumns + 1) / 2;
+
+            std::vector<juce::uint8> level((size_t)columns * numBands);
+
+            for (int c = 0; c < columns; ++c)
+            {
+                const juce::uint8* a = previous + (size_t)(2 * c) * numBands;
+                const juce::uint8* b = 2 * c + 1 < previousColumns ? a + numBands : a;
+                juce::uint8* dest = level.data() + (size_t)c * numBands;
+
+                for (int band = 0; band < numBands; ++band)
+                {
+                    dest[band] = juce::jmax(a[band], b[band]);
+                }
+            }
+
+            levels.push_back(std::move(level));
+            numColumns.push_back(columns);
+        }
+
+        buildPalette();
+    }
+
+    const SpectrogramData& getData() const { return *data; }
+
+    int getNumLevels() const { return (int)numColumns.size(); }
+    int getNumColumns(int level) const { return numColumns[(size_t)level]; }
+
+    // The coarsest level that still has at least one column per pixel
+    int getLevelForDensity(double columnsPerPixel) const
+    {
+        int level = 0;
+
+        while (level + 1 < getNumLevels() && (double)(1 << (level + 1)) <= columnsPerPixel)
+        {
+            level++;
+        }
+
+        return level;
+    }
+
+    int getNumTiles(int level) const { return (getNumColumns(level) + tileWidth - 1) / tileWidth; }
+
+    // Message thread only; band 0 is the bottom row of the image
+    const juce::Image& getTile(int level, int tileIndex)
+    {
+        useCounter++;
+
+        for (auto& tile : tiles)
+        {
+            if (tile.level == level && tile.index == tileIndex)
+            {
+                tile.lastUse = useCounter;
+
+                return tile.image;
+            }
+        }
+
+        if ((int)tiles.size() >= maxCachedTiles)
+        {
+            auto oldest = std::min_element(tiles.begin(), tiles.end(), [](const Tile& a, const Tile& b) { return a.lastUse < b.lastUse; });
+
+            tiles.erase(oldest);
+        }
+
+        tiles.push_back({ level, tileIndex, useCounter, renderTile(level, tileIndex) });
+
+        return tiles.back().image;
+    }
+
+private:
+
+    struct Tile
+    {
+        int level = 0;
+        int index = 0;
+        juce::uint32 lastUse = 0;
+        juce::Image image;
+    };
+
+    std::shared_ptr<const SpectrogramData> data;
+    std::vector<std::vector<juce::uint8>> levels;
+    std::vector<int> numColumns;
+    std::vector<Tile> tiles;
+    juce::uint32 useCounter = 0;
+    std::array<juce::Colour, 256> palette;
+
+    const juce::uint8* getLevelData(int level) const
+    {
+        return level == 0 ? data->levels.data() : levels[(size_t)level - 1].data();
+    }
+
+    // Background colour of the spectrum display at -90 dB and below, through green and gold to white at the top
+    void buildPalette()
+    {
+        juce::ColourGradient gradient(juce::Colour::fromFloatRGBA(0.12f, 0.14f, 0.13f, 1.0f), 0.0f, 0.0f, juce::Colours::white, 1.0f, 0.0f, false);
+        gradient.addColour(0.4, juce::Colours::darkgreen);
+        gradient.addColour(0.65, juce::Colours::lightgreen);
+        gradient.addColour(0.85, juce::Colours::gold);
+
+        for (int level = 0; level < 256; ++level)
+        {
+            float db = SpectrogramData::levelToDB((juce::uint8)level);
+            double position = juce::jlimit(0.0, 1.0, (db + 90.0) / 90.0);
+
+            palette[(size_t)level] = gradient.getColourAtPosition(position);
+        }
+    }
+
+    juce::Image renderTile(int level, int tileIndex) const
+    {
+        const int numBands = SpectrogramData::numBands;
+
+        juce::Image image(juce::Image::RGB, tileWidth, numBands, true);
+        juce::Image::BitmapData pixels(image, juce::Image::BitmapData::writeOnly);
+
+        const juce::uint8* levelData = getLevelData(level);
+        int firstColumn = tileIndex * tileWidth;
+        int numTileColumns = juce::jmin(tileWidth, getNumColumns(level) - firstColumn);
+
+        for (int x = 0; x < numTileColumns; ++x)
+        {
+            const juce::uint8* column = levelData + (size_t)(firstColumn + x) * numBands;
+
+            for (int band = 0; band < numBands; ++band)
+            {
+                pixels.setPixelColour(x, numBands - 1 - band, palette[column[band]]);
+            }
+        }
+
+        return image;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,233 @@
+#pragma once
+
+#include "AnalysisThreadPool.h"
+#include "SpectrogramTileCache.h"
+#include "TrackAnalysisData.h"
+#include <JuceHeader.h>
+#include <memory>
+
+// Time-frequency view of the analyzed track. Time runs left to right and frequency bottom to top on the
+// same logarithmic 20 Hz - 20 kHz axis as the spectrum. The mouse wheel zooms around the pointer, dragging
+// pans and a double click shows the whole track again. Every paint picks the mip level that matches the
+// zoom and draws the few cached tiles in view, so it costs the same for a 10-minute track as for a short one.
+class SpectrogramView : public juce::Component
+{
+public:
+
+    SpectrogramView()
+    {
+        setOpaque(true);
+    }
+
+    // The mip levels are built on the shared worker pool; a spectrogram that arrives later replaces this one
+    void setSpectrogram(std::shared_ptr<const SpectrogramData> data)
+    {
+        int jobGeneration = ++generation;
+
+        if (data == nullptr || data->isEmpty())
+        {
+            cache.reset();
+
+            repaint();
+
+            return;
+        }
+
+        juce::Component::SafePointer<SpectrogramView> safeThis(this);
+
+        pool->submit([safeThis, jobGeneration, data]
+        {
+            auto newCache = std::make_shared<SpectrogramTileCache>(data);
+
+            juce::MessageManager::callAsync([safeThis, jobGeneration, newCache]
+            {
+                if (safeThis != nullptr && jobGeneration == safeThis->generation) safeThis->applyCache(newCache);
+            });
+        });
+    }
+
+    void paint(juce::Graphics& g) override
+    {
+        g.fillAll(juce::Colour::fromFloatRGBA(0.12f, 0.14f, 0.13f, 1.0f));
+
+        auto area = getGraphArea();
+
+        if (cache == nullptr)
+        {
+            g.setColour(juce::Colours::lightgrey);
+            g.setFont(14.0f);
+            g.drawText("NO SPECTROGRAM: IT IS ONLY RECORDED FOR SINGLE-FILE FULL-TRACK ANALYSES", area, juce::Justification::centred);
+            g.setColour(juce::Colours::grey);
+            g.drawRect(area, 1.0f);
+
+            return;
+        }
+
+        drawTiles(g, area);
+        drawGrid(g, area);
+    }
+
+    void mouseWheelMove(const juce::MouseEvent& e, const juce::MouseWheelDetails& wheel) override
+    {
+        if (cache == nullptr) return;
+
+        auto area = getGraphArea();
+
+        // Horizontal scrolling pans; vertical scrolling zooms around the column under the pointer
+        if (std::abs(wheel.deltaX) > std::abs(wheel.deltaY))
+        {
+            setView(viewStart - wheel.deltaX * viewLength, viewLength);
+
+            return;
+        }
+
+        double anchor = juce::jlimit(0.0, 1.0, (double)(e.position.x - area.getX()) / area.getWidth());
+        double anchorColumn = viewStart + anchor * viewLength;
+        double newLength = viewLength * std::pow(0.5, wheel.deltaY * 2.0);
+
+        newLength = juce::jlimit(getMinViewLength(), (double)getNumColumns(), newLength);
+
+        setView(anchorColumn - anchor * newLength, newLength);
+    }
+
+    void mouseDown(const juce::MouseEvent&) override
+    {
+        dragStartView = viewStart;
+    }
+
+    void mouseDrag(const juce::MouseEvent& e) override
+    {
+        if (cache == nullptr) return;
+
+        double columnsPerPixel = viewLength / getGraphArea().getWidth();
+
+        setView(dragStartView - e.getDistanceFromDragStartX() * columnsPerPixel, viewLength);
+    }
+
+    void mouseDoubleClick(const juce::MouseEvent&) override
+    {
+        if (cache == nullptr) return;
+
+        setView(0.0, (double)getNumColumns());
+    }
+
+private:
+
+    juce::SharedResourcePointer<AnalysisThreadPool> pool;
+    std::shared_ptr<SpectrogramTileCache> cache;
+    int generation = 0;
+
+    // Visible range in level-0 columns
+    double viewStart = 0.0;
+    double viewLength = 0.0;
+    double dragStartView = 0.0;
+
+    // Same margins as the spectrum, so both graphs line up when switching views
+    juce::Rectangle<float> getGraphArea() const
+    {
+        auto bounds = getLocalBounds().toFloat();
+        
+        return bounds.withTrimmedTop(30).withTrimmedLeft(30).withTrimmedRight(30).withTrimmedBottom(30);
+    }
+
+    int getNumColumns() const { return cache != nullptr ? cache->getNumColumns(0) : 0; }
+
+    // Zooming stops at eight pixels per frame
+    double getMinViewLength() const { return juce::jmin((double)getNumColumns(), getGraphArea().getWidth() / 8.0); }
+
+    void applyCache(std::shared_ptr<SpectrogramTileCache> newCache)
+    {
+        cache = newCache;
+
+        setView(0.0, (double)getNumColumns());
+    }
+
+    void setView(double start, double length)
+    {
+        viewLength = length;
+        viewStart = juce::jlimit(0.0, juce::jmax(0.0, getNumColumns() - viewLength), start);
+
+        repaint();
+    }
+
+    void drawTiles(juce::Graphics& g, juce::Rectangle<float> area)
+    {
+        int level = cache->getLevelForDensity(viewLength / area.getWidth());
+        double levelScale = (double)(1 << level);
+        double levelStart = viewStart / levelScale;
+        double levelLength = viewLength / levelScale;
+        double pixelsPerColumn = area.getWidth() / levelLength;
+        float pixelsPerBand = area.getHeight() / SpectrogramData::numBands;
+
+        int firstTile = juce::jmax(0, (int)(levelStart / SpectrogramTileCache::tileWidth));
+        int lastTile = juce::jmin(cache->getNumTiles(level) - 1, (int)((levelStart + levelLength) / SpectrogramTileCache::tileWidth));
+
+        g.saveState();
+        g.reduceClipRegion(area.toNearestInt());
+        g.setImageResamplingQuality(juce::Graphics::lowResamplingQuality);
+
+        for (int tile = firstTile; tile <= lastTile; ++tile)
+        {
+            double tileX = area.getX() + (tile * SpectrogramTileCache::tileWidth - levelStart) * pixelsPerColumn;
+
+            g.drawImageTransformed(cache->getTile(level, tile), juce::AffineTransform::scale((float)pixelsPerColumn, pixelsPerBand).translated((float)tileX, area.getY()));
+        }
+
+        g.restoreState();
+    }
+
+    void drawGrid(juce::Graphics& g, juce::Rectangle<float> area)
+    {
+        float freqs[] = {50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000};
+
+        g.setFont(10.0f);
+
+        for (float f : freqs)
+        {
+            float normY = std::log10(f / SpectrogramData::minFrequency) / std::log10(SpectrogramData::maxFrequency / SpectrogramData::minFrequency);
+            float yPos = area.getBottom() - normY * area.getHeight();
+
+            g.setColour(juce::Colours::white.withAlpha(0.18f));
+            g.drawHorizontalLine((int)yPos, area.getX(), area.getRight());
+
+            juce::String label = f >= 1000 ? juce::String((int)(f / 1000)) + "k" : juce::String((int)f);
+
+            g.setColour(juce::Colours::lightgrey);
+            g.drawText(label, (int)area.getX() - 33, (int)yPos - 6, 30, 12, juce::Justification::centredRight);
+        }
+
+        // Time labels at the first step that leaves at least 80 pixels between them
+        double secondsPerColumn = cache->getData().getSecondsPerColumn();
+        double secondsPerPixel = viewLength * secondsPerColumn / area.getWidth();
+        double steps[] = {0.5, 1, 2, 5, 10, 15, 30, 60, 120, 300, 600};
+        double step = steps[0];
+
+        for (double s : steps)
+        {
+            step = s;
+
+            if (s / secondsPerPixel >= 80.0) break;
+        }
+
+        double viewStartSeconds = viewStart * secondsPerColumn;
+
+        for (double t = std::ceil(viewStartSeconds / step) * step; t <= (viewStart + viewLength) * secondsPerColumn; t += step)
+        {
+            float xPos = area.getX() + (float)((t - viewStartSeconds) / secondsPerPixel);
+
+            g.setColour(juce::Colours::white.withAlpha(0.18f));
+            g.drawVerticalLine((int)xPos, area.getY(), area.getBottom());
+
+            int seconds = (int)t;
+            juce::String label = juce::String::formatted("%d:%02d", seconds / 60, seconds % 60);
+
+            if (step < 1.0) label << "." << (int)std::round((t - seconds) * 10.0);
+
+            g.setColour(juce::Colours::lightgrey);
+            g.drawText(label, (int)xPos - 25, (int)area.getBottom() + 2, 50, 15, juce::Justification::centredTop);
+        }
+
+        g.setColour(juce::Colours::grey);
+        g.drawRect(area, 1.0f);
+    }
+};
\ No newline at end of file
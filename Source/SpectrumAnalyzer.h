@@ -1,6 +1,14 @@
 #pragma once
 
+#include "AnalysisThreadPool.h"
+#include "SpectrumHoverOverlay.h"
+#include "SpectrumProcessor.h"
+#include "SpectrumSmoother.h"
+#include "TrackAnalysisData.h"
 #include <JuceHeader.h>
+#include <array>
+#include <memory>
+#include <tuple>
 
 class SpectrumAnalyzer : public juce::Component
 {
@@ -14,135 +22,102 @@ public:
         bool showMidMax = false;
         bool showSideAvg = false;
         bool showSideMax = false;
+
+        bool operator==(const DisplaySettings& other) const { return tie() == other.tie(); }
+        bool operator!=(const DisplaySettings& other) const { return tie() != other.tie(); }
+
+    private:
+
+        auto tie() const { return std::tie(showStereoAvg, showStereoMax, showMidAvg, showMidMax, showSideAvg, showSideMax); }
     } settings;
 
     SpectrumAnalyzer()
     {
-        fftOrder = 14;
-        fftSize = 1 << fftOrder;
-        forwardFFT = std::make_unique<juce::dsp::FFT>(fftOrder);
-        window = std::make_unique<juce::dsp::WindowingFunction<float>>(fftSize, juce::dsp::WindowingFunction<float>::hann);
-
+        // The layer cache covers every pixel, so nothing behind the graph needs painting when the overlay moves
+        setOpaque(true);
         setInterceptsMouseClicks(true, false);
+
+        addAndMakeVisible(hoverOverlay);
     }
 
     void mouseEnter(const juce::MouseEvent& e) override
     {
-        isMouseOverGraph = true;
-
-        repaint();
+        hoverOverlay.setMousePosition(e.getPosition());
     }
     
-    void mouseExit(const juce::MouseEvent& e) override
+    void mouseExit(const juce::MouseEvent&) override
     {
-        isMouseOverGraph = false;
-        
-        repaint();
+        hoverOverlay.clearMousePosition();
     }
     
     void mouseMove(const juce::MouseEvent& e) override
     {
-        isMouseOverGraph = true;
-        mousePos = e.getPosition();
-
-        repaint();
+        hoverOverlay.setMousePosition(e.getPosition());
     }
 
-    void setSmoothingOctave(float octaveFactor)
+    void resized() override
     {
-        if (std::abs(currentSmoothingFactor - octaveFactor) < 0.001f) return;
-
-        currentSmoothingFactor = octaveFactor;
+        layersDirty = true;
 
-        reprocessSmoothing();
+        hoverOverlay.setBounds(getLocalBounds());
+        hoverOverlay.setGraphArea(getAnalysisArea());
     }
 
-    void analyzeBuffer(const juce::AudioBuffer<float>& inputBuffer, double sampleRate)
-    {
-        currentSampleRate = sampleRate;
-
-        if (currentSampleRate <= 0 || inputBuffer.getNumSamples() == 0) return;
-
-        juce::AudioBuffer<float> buffer;
-        buffer.makeCopyOf(inputBuffer);
+    // Octave fractions of the smoothing levels, from RAW to 1 OCT
+    static constexpr int numSmoothingLevels = 8;
+    static constexpr std::array<float, numSmoothingLevels> smoothingFactors = { 0.0f, 0.02f, 0.04f, 0.08f, 0.15f, 0.3f, 0.5f, 0.8f };
 
-        AnalysisPrep::cropToLoudestSection(buffer, sampleRate, 20.0);
-
-        int numBins = fftSize / 2;
-
-        accMid.assign(numBins, 0.0f);
-        accSide.assign(numBins, 0.0f);
-        accStereo.assign(numBins, 0.0f);
-
-        float minMag = 1e-9f;
-
-        rawMaxMidMag.assign(numBins, minMag);
-        rawMaxSideMag.assign(numBins, minMag);
-        rawMaxStereoMag.assign(numBins, minMag);
-
-        std::vector<float> midData(fftSize * 2, 0.0f);
-        std::vector<float> sideData(fftSize * 2, 0.0f);
+    // Every level is computed in the background as soon as a spectrum arrives, so switching only swaps a pointer
+    void setSmoothingLevel(int level)
+    {
+        if (!juce::isPositiveAndBelow(level, numSmoothingLevels) || level == currentLevel) return;
 
-        int numSamples = buffer.getNumSamples();
-        int hopSize = fftSize / 4;
-        int numBlocks = 0;
-        float windowCorrection = 2.0f;
+        currentLevel = level;
 
-        for (int i = 0; i < numSamples - fftSize; i += hopSize)
+        if (levelCurves[(size_t)level] != nullptr)
         {
-            for (int j = 0; j < fftSize; ++j)
-            {
-                float l = buffer.getSample(0, i + j);
-                float r = (buffer.getNumChannels() > 1) ? buffer.getSample(1, i + j) : l;
+            curves = levelCurves[(size_t)level];
+            currentSampleRate = curves->sampleRate;
+            layersDirty = true;
 
-                midData[j] = (l + r) * 0.5f;
-                sideData[j] = (l - r) * 0.5f;
-            }
+            repaint();
+        }
+    }
 
-            window->multiplyWithWindowingTable(midData.data(), fftSize);
-            window->multiplyWithWindowingTable(sideData.data(), fftSize);
-            forwardFFT->performFrequencyOnlyForwardTransform(midData.data());
-            forwardFFT->performFrequencyOnlyForwardTransform(sideData.data());
+    // The spectrum itself comes from the analysis engine; smoothing and dB conversion run on the shared
+    // worker pool, so paint only ever sees finished dB arrays
+    void setSpectrumData(std::shared_ptr<const SpectrumData> data)
+    {
+        if (data == nullptr || data->isEmpty()) return;
 
-            for (int j = 0; j < numBins; ++j)
-            {
-                if (j == 0)
-                {
-                    midData[j] = 0.0f;
-                    sideData[j] = 0.0f;
-                }
+        rawData = std::move(data);
 
-                float midMag = midData[j] * windowCorrection;
-                float sideMag = sideData[j] * windowCorrection;
-                float stereoPower = (midMag * midMag) + (sideMag * sideMag);
-                float stereoMag = std::sqrt(stereoPower);
+        scheduleProcessing(rawData);
+    }
 
-                accMid[j] += midMag * midMag;
-                accSide[j] += sideMag * sideMag;
-                accStereo[j] += stereoPower;
+    void paint(juce::Graphics& g) override
+    {
+        float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
 
-                if (midMag > rawMaxMidMag[j]) rawMaxMidMag[j] = midMag;
+        // The layers are only rendered again when the curves, the size, the toggles or the display scale change
+        if (layersDirty || settings != renderedSettings || scale != layerScale || layerCache.isNull()) renderLayers(scale);
 
-                if (sideMag > rawMaxSideMag[j]) rawMaxSideMag[j] = sideMag;
-                
-                if (stereoMag > rawMaxStereoMag[j]) rawMaxStereoMag[j] = stereoMag;
-            }
+        g.drawImageTransformed(layerCache, juce::AffineTransform::scale(1.0f / layerScale));
+    }
 
-            numBlocks++;
-        }
+private:
 
-        if (numBlocks > 0)
-        {
-            rawAvgMidMag = calculateAverageMagnitude(accMid, numBlocks);
-            rawAvgSideMag = calculateAverageMagnitude(accSide, numBlocks);
-            rawAvgStereoMag = calculateAverageMagnitude(accStereo, numBlocks);
+    // Grid, legend and every visible curve, drawn into an image at the display's pixel scale
+    void renderLayers(float scale)
+    {
+        layerCache = juce::Image(juce::Image::RGB, juce::jmax(1, juce::roundToInt(getWidth() * scale)), juce::jmax(1, juce::roundToInt(getHeight() * scale)), false);
+        layerScale = scale;
+        renderedSettings = settings;
+        layersDirty = false;
 
-            reprocessSmoothing();
-        }
-    }
+        juce::Graphics g(layerCache);
+        g.addTransform(juce::AffineTransform::scale(scale));
 
-    void paint(juce::Graphics& g) override
-    {
         g.fillAll(juce::Colour::fromFloatRGBA(0.12f, 0.14f, 0.13f, 1.0f));
 
         auto area = getAnalysisArea();
@@ -150,7 +125,16 @@ public:
         drawLegend(g);
         drawGrid(g, area);
 
-        if (currentSampleRate <= 0) return;
+        if (curves == nullptr) return;
+
+        updatePixelMap(area.getWidth(), curves->avgStereoDB.size());
+
+        auto& avgMidDB = curves->avgMidDB;
+        auto& avgSideDB = curves->avgSideDB;
+        auto& avgStereoDB = curves->avgStereoDB;
+        auto& maxMidDB = curves->maxMidDB;
+        auto& maxSideDB = curves->maxSideDB;
+        auto& maxStereoDB = curves->maxStereoDB;
 
         g.saveState();
         g.reduceClipRegion(area.toNearestInt());
@@ -174,120 +158,150 @@ public:
         if (settings.showMidAvg && settings.showSideAvg) drawOverlapWarning(g, avgMidDB, avgSideDB, area);
 
         g.restoreState();
-
-        if (isMouseOverGraph && area.contains(mousePos.toFloat())) drawHoverOverlay(g, area);
     }
 
-private:
-
-    int fftOrder;
-    int fftSize;
-    std::unique_ptr<juce::dsp::FFT> forwardFFT;
-    std::unique_ptr<juce::dsp::WindowingFunction<float>> window;
-    std::vector<float> accMid, accSide, accStereo;
-    std::vector<float> rawAvgMidMag, rawAvgSideMag, rawAvgStereoMag;
-    std::vector<float> rawMaxMidMag, rawMaxSideMag, rawMaxStereoMag;
-    std::vector<float> avgMidDB, avgSideDB, avgStereoDB;
-    std::vector<float> maxMidDB, maxSideDB, maxStereoDB;
-    double currentSampleRate = 0.0;
-    float currentSmoothingFactor = 0.3f;
-    juce::Point<int> mousePos;
-    bool isMouseOverGraph = false;
+    static constexpr int fftSize = SpectrumProcessor::fftSize;
 
-    juce::Rectangle<float> getAnalysisArea()
+    // The six smoothed, tilted dB curves of one smoothing level; never modified once published
+    struct DisplayCurves
     {
-        auto bounds = getLocalBounds().toFloat();
-        
-        return bounds.withTrimmedTop(30).withTrimmedLeft(30).withTrimmedRight(30).withTrimmedBottom(30);
-    }
+        double sampleRate = 0.0;
+        std::vector<float> avgMidDB, avgSideDB, avgStereoDB;
+        std::vector<float> maxMidDB, maxSideDB, maxStereoDB;
+    };
 
-    std::vector<float> calculateAverageMagnitude(const std::vector<float>& accumulated, int numBlocks)
+    juce::SharedResourcePointer<AnalysisThreadPool> pool;
+    std::shared_ptr<const SpectrumData> rawData;
+
+    // About 200 KB per level; the cache is dropped when the next spectrum arrives
+    std::array<std::shared_ptr<const DisplayCurves>, numSmoothingLevels> levelCurves;
+    std::shared_ptr<const DisplayCurves> curves;
+    double currentSampleRate = 0.0;
+    int currentLevel = 5; // 1/3 OCT
+    int generation = 0;
+    SpectrumHoverOverlay hoverOverlay;
+
+    juce::Image layerCache;
+    float layerScale = 1.0f;
+    DisplaySettings renderedSettings;
+    bool layersDirty = true;
+
+    // Interpolation bins of every pixel column, so drawing needs no pow and no division per pixel.
+    // Columns span 20 Hz to 20 kHz, so the fade applied outside that range never comes into play here.
+    struct PixelBinMap
     {
-        std::vector<float> result(accumulated.size());
+        float width = 0.0f;
+        double sampleRate = 0.0;
+        size_t numBins = 0;
+        std::vector<int> lower, upper;
+        std::vector<float> frac;
+    } pixelMap;
+
+    void updatePixelMap(float width, size_t numBins)
+    {
+        if (pixelMap.width == width && pixelMap.sampleRate == currentSampleRate && pixelMap.numBins == numBins) return;
 
-        float norm = 1.0f / (float)numBlocks;
+        pixelMap.width = width;
+        pixelMap.sampleRate = currentSampleRate;
+        pixelMap.numBins = numBins;
 
-        for (size_t i = 0; i < accumulated.size(); ++i)
-        {
-            result[i] = std::sqrt(accumulated[i] * norm);
-        }
+        size_t numColumns = (size_t)juce::jmax(0, (int)std::ceil(width));
 
-        return result;
-    }
+        pixelMap.lower.assign(numColumns, 0);
+        pixelMap.upper.assign(numColumns, 0);
+        pixelMap.frac.assign(numColumns, 0.0f);
 
-    void reprocessSmoothing()
-    {
-        auto tempAvgMid = rawAvgMidMag; auto tempAvgSide = rawAvgSideMag; auto tempAvgStereo = rawAvgStereoMag;
-        auto tempMaxMid = rawMaxMidMag; auto tempMaxSide = rawMaxSideMag; auto tempMaxStereo = rawMaxStereoMag;
+        if (numBins == 0) return;
 
-        applyMagnitudeSmoothing(tempAvgMid); applyMagnitudeSmoothing(tempAvgSide); applyMagnitudeSmoothing(tempAvgStereo);
-        applyMagnitudeSmoothing(tempMaxMid); applyMagnitudeSmoothing(tempMaxSide); applyMagnitudeSmoothing(tempMaxStereo);
-
-        float slope = 4.5f;
+        float nyquist = currentSampleRate * 0.5f;
+        int lastBin = (int)numBins - 1;
 
-        avgMidDB = convertToDbWithSlope(tempAvgMid, slope);
-        avgSideDB = convertToDbWithSlope(tempAvgSide, slope);
-        avgStereoDB = convertToDbWithSlope(tempAvgStereo, slope);
-        maxMidDB = convertToDbWithSlope(tempMaxMid, slope);
-        maxSideDB = convertToDbWithSlope(tempMaxSide, slope);
-        maxStereoDB = convertToDbWithSlope(tempMaxStereo, slope);
+        for (size_t x = 0; x < numColumns; ++x)
+        {
+            float normX = (float)x / width;
+            float freq = 20.0f * std::pow(20000.0f / 20.0f, normX);
+            float binPos = freq >= nyquist ? (float)lastBin : (freq / nyquist) * lastBin;
+            int index = juce::jlimit(0, lastBin, (int)binPos);
 
-        repaint();
+            pixelMap.lower[x] = index;
+            pixelMap.upper[x] = juce::jmin(index + 1, lastBin);
+            pixelMap.frac[x] = index < lastBin ? binPos - index : 0.0f;
+        }
     }
 
-    void applyMagnitudeSmoothing(std::vector<float>& data)
+    float getPixelDB(int x, const std::vector<float>& data) const
     {
-        if (data.empty() || currentSampleRate <= 0) return;
+        if (data.size() != pixelMap.numBins || !juce::isPositiveAndBelow(x, (int)pixelMap.frac.size())) return -144.0f;
 
-        if (currentSmoothingFactor <= 0.001f) return;
+        float frac = pixelMap.frac[(size_t)x];
 
-        auto temp = data;
-
-        performSinglePassSmoothing(data, temp);
-        performSinglePassSmoothing(temp, data);
+        return data[(size_t)pixelMap.lower[(size_t)x]] * (1.0f - frac) + data[(size_t)pixelMap.upper[(size_t)x]] * frac;
     }
 
-    void performSinglePassSmoothing(const std::vector<float>& input, std::vector<float>& output)
+    // One job per level, the visible level first. Results of a superseded spectrum are dropped.
+    void scheduleProcessing(std::shared_ptr<const SpectrumData> raw)
     {
-        int size = (int)input.size();
+        int jobGeneration = ++generation;
+        juce::Component::SafePointer<SpectrumAnalyzer> safeThis(this);
 
-        for (int i = 0; i < size; ++i)
-        {
-            float freq = (i * currentSampleRate) / fftSize;
-            float bandwidth = freq * currentSmoothingFactor;
+        levelCurves.fill(nullptr);
 
-            if (bandwidth < 10.0f) bandwidth = 10.0f;
+        for (int i = 0; i < numSmoothingLevels; ++i)
+        {
+            int level = (currentLevel + i) % numSmoothingLevels;
 
-            int radius = (int)((bandwidth / currentSampleRate) * fftSize * 0.5f);
+            pool->submit([safeThis, jobGeneration, level, raw]
+            {
+                float smoothingFactor = smoothingFactors[(size_t)level];
+
+                auto result = std::make_shared<DisplayCurves>();
+                result->sampleRate = raw->sampleRate;
+                result->avgMidDB = processDisplayCurve(raw->avgMid, raw->sampleRate, smoothingFactor);
+                result->avgSideDB = processDisplayCurve(raw->avgSide, raw->sampleRate, smoothingFactor);
+                result->avgStereoDB = processDisplayCurve(raw->avgStereo, raw->sampleRate, smoothingFactor);
+                result->maxMidDB = processDisplayCurve(raw->maxMid, raw->sampleRate, smoothingFactor);
+                result->maxSideDB = processDisplayCurve(raw->maxSide, raw->sampleRate, smoothingFactor);
+                result->maxStereoDB = processDisplayCurve(raw->maxStereo, raw->sampleRate, smoothingFactor);
+
+                juce::MessageManager::callAsync([safeThis, jobGeneration, level, result]
+                {
+                    if (safeThis != nullptr) safeThis->applyDisplayCurves(jobGeneration, level, result);
+                });
+            });
+        }
+    }
 
-            if (radius < 1) radius = 1;
+    void applyDisplayCurves(int jobGeneration, int level, std::shared_ptr<const DisplayCurves> result)
+    {
+        if (jobGeneration != generation) return;
 
-            int spaceRight = (size - 1) - i;
-            int spaceLeft = i;
-            int effectiveRadius = radius;
+        levelCurves[(size_t)level] = result;
 
-            if (effectiveRadius > spaceRight) effectiveRadius = spaceRight;
+        if (level != currentLevel) return;
 
-            if (effectiveRadius > spaceLeft)  effectiveRadius = spaceLeft;
+        curves = result;
+        currentSampleRate = result->sampleRate;
+        layersDirty = true;
 
-            int start = i - effectiveRadius;
-            int end = i + effectiveRadius;
+        repaint();
+    }
 
-            float sum = 0.0f;
-            int count = 0;
+    juce::Rectangle<float> getAnalysisArea() const
+    {
+        auto bounds = getLocalBounds().toFloat();
+        
+        return bounds.withTrimmedTop(30).withTrimmedLeft(30).withTrimmedRight(30).withTrimmedBottom(30);
+    }
 
-            for (int k = start; k <= end; ++k)
-            {
-                sum += input[k];
-                count++;
-            }
+    // Pure functions of their arguments, so they can run on any pool worker
+    static std::vector<float> processDisplayCurve(std::vector<float> magnitudes, double sampleRate, float smoothingFactor)
+    {
+        if (smoothingFactor > 0.001f && sampleRate > 0) SpectrumSmoother::get(sampleRate, fftSize, smoothingFactor)->apply(magnitudes);
 
-            if (count > 0) output[i] = sum / count;
-            else output[i] = input[i];
-        }
+        return convertToDbWithSlope(magnitudes, sampleRate, 4.5f);
     }
 
-    std::vector<float> convertToDbWithSlope(const std::vector<float>& magData, float slope)
+    static std::vector<float> convertToDbWithSlope(const std::vector<float>& magData, double currentSampleRate, float slope)
     {
         std::vector<float> dbData(magData.size());
 
@@ -309,42 +323,6 @@ private:
         return dbData;
     }
 
-    float getVisualDB(float freq, const std::vector<float>& data)
-    {
-        if (data.empty()) return -144.0f;
-
-        float db = -144.0f;
-        float nyquist = currentSampleRate * 0.5f;
-
-        if (freq >= nyquist) db = data.back();
-        else
-        {
-            float binPos = (freq / nyquist) * (data.size() - 1);
-            int index = (int)binPos; float frac = binPos - index;
-
-            if (index < 0) db = data.front();
-            else if (index >= data.size() - 1) db = data.back();
-            else db = data[index] * (1.0f - frac) + data[index + 1] * frac;
-        }
-
-        if (freq > 20000.0f)
-        {
-            float t = juce::jmap(freq, 20000.0f, 22000.0f, 0.0f, 1.0f);
-
-            t = juce::jlimit(0.0f, 1.0f, t);
-            db = db * (1.0f - t) + (-84.0f * t);
-        }
-        else if (freq < 20.0f)
-        {
-            float t = 1.0f - (freq / 20.0f);
-
-            t = juce::jlimit(0.0f, 1.0f, t);
-            db = db * (1.0f - t) + (-84.0f * t);
-        }
-
-        return db;
-    }
-
     void drawOverlapWarning(juce::Graphics& g, const std::vector<float>& midDBs, const std::vector<float>& sideDBs, juce::Rectangle<float> bounds)
     {
         if (midDBs.empty() || sideDBs.empty()) return;
@@ -353,10 +331,8 @@ private:
 
         for (int x = 1; x < bounds.getWidth(); ++x)
         {
-            float normX = (float)x / bounds.getWidth();
-            float freq = 20.0f * std::pow(20000.0f / 20.0f, normX);
-            float midDB = getVisualDB(freq, midDBs);
-            float sideDB = getVisualDB(freq, sideDBs);
+            float midDB = getPixelDB(x, midDBs);
+            float sideDB = getPixelDB(x, sideDBs);
 
             if (sideDB > midDB)
             {
@@ -380,9 +356,7 @@ private:
 
         auto getY = [&](int xPixel) -> float
         {
-            float normX = (float)xPixel / bounds.getWidth();
-            float freq = 20.0f * std::pow(20000.0f / 20.0f, normX);
-            float db = getVisualDB(freq, sideDBs);
+            float db = getPixelDB(xPixel, sideDBs);
 
             if (db < -84.0f) db = -84.0f;
 
@@ -395,9 +369,8 @@ private:
 
         float currentY = getY(0);
         float currentX = bounds.getX();
-        float startFreq = 20.0f;
-        float startSideVal = getVisualDB(startFreq, sideDBs);
-        float startMidVal = getVisualDB(startFreq, midDBs);
+        float startSideVal = getPixelDB(0, sideDBs);
+        float startMidVal = getPixelDB(0, midDBs);
         bool prevWasAlert = (startSideVal > startMidVal);
 
         if (prevWasAlert) alertPath.startNewSubPath(currentX, currentY);
@@ -405,10 +378,8 @@ private:
 
         for (int x = 1; x < bounds.getWidth(); ++x)
         {
-            float normX = (float)x / bounds.getWidth();
-            float freq = 20.0f * std::pow(20000.0f / 20.0f, normX);
-            float sideVal = getVisualDB(freq, sideDBs);
-            float midVal = getVisualDB(freq, midDBs);
+            float sideVal = getPixelDB(x, sideDBs);
+            float midVal = getPixelDB(x, midDBs);
             bool isAlert = (sideVal > midVal);
             float nextX = bounds.getX() + x;
             float nextY = getY(x);
@@ -444,16 +415,13 @@ private:
         juce::Path path;
         float minDB = -84.0f; float maxDB = 0.0f;
         path.startNewSubPath(bounds.getX(), bounds.getBottom());
-        float startFreq = 20.0f;
-        float startDB = getVisualDB(startFreq, dbs);
+        float startDB = getPixelDB(0, dbs);
         float startY = bounds.getY() + (juce::jmap(startDB, minDB, maxDB, 1.0f, 0.0f) * bounds.getHeight());
         path.lineTo(bounds.getX(), startY);
 
         for (int x = 1; x < bounds.getWidth(); ++x)
         {
-            float normX = (float)x / bounds.getWidth();
-            float freq = 20.0f * std::pow(20000.0f / 20.0f, normX);
-            float db = getVisualDB(freq, dbs);
+            float db = getPixelDB(x, dbs);
 
             if (db < minDB) db = minDB;
 
@@ -532,40 +500,6 @@ private:
         g.drawRect(bounds, 1.0f);
     }
 
-    void drawHoverOverlay(juce::Graphics& g, juce::Rectangle<float> bounds)
-    {
-        float mouseX = juce::jlimit(bounds.getX(), bounds.getRight(), (float)mousePos.x);
-        float mouseY = juce::jlimit(bounds.getY(), bounds.getBottom(), (float)mousePos.y);
-
-        g.setColour(juce::Colours::white.withAlpha(0.5f));
-        g.drawVerticalLine((int)mouseX, bounds.getY(), bounds.getBottom());
-        g.drawHorizontalLine((int)mouseY, bounds.getX(), bounds.getRight());
-
-        float normX = (mouseX - bounds.getX()) / bounds.getWidth();
-        float freq = 20.0f * std::pow(20000.0f / 20.0f, normX);
-        float normY = (mouseY - bounds.getY()) / bounds.getHeight();
-        float db = 0.0f - (normY * (0.0f - (-84.0f)));
-
-        juce::String text = juce::String((int)freq) + " Hz | " + juce::String(db, 1) + " dB";
-
-        int boxW = 110;
-        int boxH = 20;
-        int boxX = (int)mouseX + 10;
-        int boxY = (int)mouseY - 25;
-
-        if (boxX + boxW > bounds.getRight()) boxX = (int)mouseX - boxW - 10;
-
-        if (boxY < bounds.getY()) boxY = (int)mouseY + 10;
-
-        g.setColour(juce::Colours::black.withAlpha(0.8f));
-        g.fillRoundedRectangle((float)boxX, (float)boxY, (float)boxW, (float)boxH, 4.0f);
-        g.setColour(juce::Colours::white);
-        g.drawRoundedRectangle((float)boxX, (float)boxY, (float)boxW, (float)boxH, 4.0f, 1.0f);
-        g.setFont(12.0f);
-        g.drawText(text, boxX, boxY, boxW, boxH, juce::Justification::centred);
-        g.fillEllipse(mouseX - 3, mouseY - 3, 6, 6);
-    }
-
     void drawLegend(juce::Graphics& g)
     {
         int x = getWidth() - 250;
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Crosshair and frequency/dB readout of the spectrum graph, kept in its own transparent component on top of
+// the graph. Moving the mouse only repaints the old and new crosshair and box, which the graph underneath
+// fills from its cached image, so hovering never redraws a curve.
+class SpectrumHoverOverlay : public juce::Component
+{
+public:
+
+    SpectrumHoverOverlay()
+    {
+        setInterceptsMouseClicks(false, false);
+    }
+
+    // The grid area in this component's coordinates; the crosshair is only shown inside it
+    void setGraphArea(juce::Rectangle<float> newArea)
+    {
+        repaintCrosshair();
+
+        graphArea = newArea;
+
+        repaintCrosshair();
+    }
+
+    void setMousePosition(juce::Point<int> newPosition)
+    {
+        if (hasMouse && newPosition == mousePos) return;
+
+        repaintCrosshair();
+
+        hasMouse = true;
+        mousePos = newPosition;
+
+        repaintCrosshair();
+    }
+
+    void clearMousePosition()
+    {
+        repaintCrosshair();
+
+        hasMouse = false;
+    }
+
+    void paint(juce::Graphics& g) override
+    {
+        if (!isCrosshairVisible()) return;
+
+        auto bounds = graphArea;
+        float mouseX = juce::jlimit(bounds.getX(), bounds.getRight(), (float)mousePos.x);
+        float mouseY = juce::jlimit(bounds.getY(), bounds.getBottom(), (float)mousePos.y);
+
+        g.setColour(juce::Colours::white.withAlpha(0.5f));
+        g.drawVerticalLine((int)mouseX, bounds.getY(), bounds.getBottom());
+        g.drawHorizontalLine((int)mouseY, bounds.getX(), bounds.getRight());
+
+        float normX = (mouseX - bounds.getX()) / bounds.getWidth();
+        float freq = 20.0f * std::pow(20000.0f / 20.0f, normX);
+        float normY = (mouseY - bounds.getY()) / bounds.getHeight();
+        float db = 0.0f - (normY * (0.0f - (-84.0f)));
+
+        juce::String text = juce::String((int)freq) + " Hz | " + juce::String(db, 1) + " dB";
+
+        auto box = getBoxBounds(mouseX, mouseY);
+
+        g.setColour(juce::Colours::black.withAlpha(0.8f));
+        g.fillRoundedRectangle(box.toFloat(), 4.0f);
+        g.setColour(juce::Colours::white);
+        g.drawRoundedRectangle(box.toFloat(), 4.0f, 1.0f);
+        g.setFont(12.0f);
+        g.drawText(text, box, juce::Justification::centred);
+        g.fillEllipse(mouseX - 3, mouseY - 3, 6, 6);
+    }
+
+private:
+
+    juce::Rectangle<float> graphArea;
+    juce::Point<int> mousePos;
+    bool hasMouse = false;
+
+    bool isCrosshairVisible() const
+    {
+        return hasMouse && graphArea.contains(mousePos.toFloat());
+    }
+
+    juce::Rectangle<int> getBoxBounds(float mouseX, float mouseY) const
+    {
+        int boxW = 110;
+        int boxH = 20;
+        int boxX = (int)mouseX + 10;
+        int boxY = (int)mouseY - 25;
+
+        if (boxX + boxW > graphArea.getRight()) boxX = (int)mouseX - boxW - 10;
+
+        if (boxY < graphArea.getY()) boxY = (int)mouseY + 10;
+
+        return { boxX, boxY, boxW, boxH };
+    }
+
+    // Both lines, the dot and the readout box; the rest of the overlay is always empty
+    void repaintCrosshair()
+    {
+        if (!isCrosshairVisible()) return;
+
+        float mouseX = juce::jlimit(graphArea.getX(), graphArea.getRight(), (float)mousePos.x);
+        float mouseY = juce::jlimit(graphArea.getY(), graphArea.getBottom(), (float)mousePos.y);
+
+        repaint(juce::Rectangle<float>(mouseX - 1.0f, graphArea.getY(), 3.0f, graphArea.getHeight()).getSmallestIntegerContainer());
+        repaint(juce::Rectangle<float>(graphArea.getX(), mouseY - 1.0f, graphArea.getWidth(), 3.0f).getSmallestIntegerContainer());
+        repaint(juce::Rectangle<float>(mouseX - 4.0f, mouseY - 4.0f, 8.0f, 8.0f).getSmallestIntegerContainer());
+        repaint(getBoxBounds(mouseX, mouseY).expanded(2));
+    }
+};
\ No newline at end of file
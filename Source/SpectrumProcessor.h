@@ -0,0 +1,383 @@
+#pragma once
+
+#include "AnalysisPrep.h"
+#include "AnalysisThreadPool.h"
+#include "TrackAnalysisData.h"
+#include <JuceHeader.h>
+#include <atomic>
+#include <cstring>
+
+// GUI-free spectrum math: averaged and max-hold mid/side/stereo magnitude spectra. The whole track is
+// streamed block by block through a fixed-size window of pending samples, so memory stays constant however
+// long the file is; process() keeps the quick look over the loudest 20 s of a buffer. Shared by the engine,
+// the SpectrumAnalyzer component and the headless command-line analyzer. Frames are independent, so each
+// batch of complete frames is split across the shared worker pool and the slices are reduced at the end.
+// Optionally every frame also leaves a compact spectrogram column behind, the only part that grows with length.
+class SpectrumProcessor
+{
+public:
+
+    static constexpr int fftOrder = 14;
+    static constexpr int fftSize = 1 << fftOrder;
+
+    // Starts a new stream; blocks must then be pushed in order
+    void reset(double newSampleRate, bool captureSpectrogram = false)
+    {
+        sampleRate = newSampleRate;
+        numPendingSamples = 0;
+        isStereo = false;
+
+        spectrogram.reset();
+
+        if (captureSpectrogram)
+        {
+            spectrogram = std::make_unique<SpectrogramData>();
+            spectrogram->sampleRate = sampleRate;
+            spectrogram->hopSize = hopSize;
+
+            buildBandTable();
+        }
+
+        pending.setSize(2, pendingCapacity, false, false, true);
+
+        // One kernel and accumulator per worker plus the calling thread, allocated once and then reused
+        int numSlices = pool->getNumWorkers() + 1;
+
+        if ((int)kernels.size() != numSlices)
+        {
+            kernels.clear();
+
+            for (int i = 0; i < numSlices; ++i)
+            {
+                kernels.push_back(std::make_unique<FrameKernel>());
+            }
+        }
+
+        slices.assign((size_t)numSlices, PowerAccumulator());
+    }
+
+    void pushBlock(const juce::AudioBuffer<float>& block, int numSamples)
+    {
+        if (block.getNumChannels() > 1) isStereo = true;
+
+        for (int offset = 0; offset < numSamples; )
+        {
+            int toCopy = juce::jmin(numSamples - offset, pendingCapacity - numPendingSamples);
+
+            pending.copyFrom(0, numPendingSamples, block, 0, offset, toCopy);
+            pending.copyFrom(1, numPendingSamples, block, juce::jmin(1, block.getNumChannels() - 1), offset, toCopy);
+
+            numPendingSamples += toCopy;
+            offset += toCopy;
+
+            if (numPendingSamples == pendingCapacity) transformPendingFrames();
+        }
+    }
+
+    // Transforms the remaining complete frames and returns the spectrum of everything pushed since reset
+    SpectrumData getResult()
+    {
+        if (slices.empty()) return {};
+
+        transformPendingFrames();
+
+        PowerAccumulator& acc = slices.front();
+
+        for (size_t slice = 1; slice < slices.size(); ++slice)
+        {
+            acc.add(slices[slice]);
+        }
+
+        if (acc.numFrames == 0) return {};
+
+        SpectrumData data;
+        data.sampleRate = sampleRate;
+        data.avgMid = calculateAverageMagnitude(acc.sumMid, acc.numFrames);
+        data.avgSide = calculateAverageMagnitude(acc.sumSide, acc.numFrames);
+        data.avgStereo = calculateAverageMagnitude(acc.sumStereo, acc.numFrames);
+        data.maxMid = calculatePeakMagnitude(acc.peakMid);
+        data.maxSide = calculatePeakMagnitude(acc.peakSide);
+        data.maxStereo = calculatePeakMagnitude(acc.peakStereo);
+        data.spectrogram = std::move(spectrogram);
+
+        slices.assign(slices.size(), PowerAccumulator());
+
+        return data;
+    }
+
+    // Quick look: only the loudest 20 s of the buffer
+    SpectrumData process(const juce::AudioBuffer<float>& inputBuffer, double newSampleRate)
+    {
+        if (newSampleRate <= 0 || inputBuffer.getNumSamples() == 0) return {};
+
+        juce::AudioBuffer<float> buffer;
+        buffer.makeCopyOf(inputBuffer);
+
+        AnalysisPrep::cropToLoudestSection(buffer, newSampleRate, 20.0);
+
+        reset(newSampleRate);
+        pushBlock(buffer, buffer.getNumSamples());
+
+        return getResult();
+    }
+
+private:
+
+    static constexpr int numBins = fftSize / 2;
+
+    static constexpr int hopSize = fftSize / 4;
+
+    // Room for a batch of frames per dispatch to the pool; the overlap of the last frame is carried over
+    static constexpr int pendingCapacity = fftSize + 32 * hopSize;
+
+    juce::SharedResourcePointer<AnalysisThreadPool> pool;
+    juce::AudioBuffer<float> pending;
+    int numPendingSamples = 0;
+    bool isStereo = false;
+    double sampleRate = 0.0;
+
+    // Per-bin power sums and peaks; magnitudes are only taken once all frames are in
+    struct PowerAccumulator
+    {
+        std::vector<float> sumMid = std::vector<float>(numBins, 0.0f);
+        std::vector<float> sumSide = std::vector<float>(numBins, 0.0f);
+        std::vector<float> sumStereo = std::vector<float>(numBins, 0.0f);
+        std::vector<float> peakMid = std::vector<float>(numBins, 0.0f);
+        std::vector<float> peakSide = std::vector<float>(numBins, 0.0f);
+        std::vector<float> peakStereo = std::vector<float>(numBins, 0.0f);
+        std::vector<float> midPower = std::vector<float>(numBins, 0.0f);
+        std::vector<float> sidePower = std::vector<float>(numBins, 0.0f);
+        std::vector<float> stereoPower = std::vector<float>(numBins, 0.0f);
+        int numFrames = 0;
+
+        // Reduction of another slice: sums add up, peaks take the per-bin maximum
+        void add(const PowerAccumulator& other)
+        {
+            juce::FloatVectorOperations::add(sumMid.data(), other.sumMid.data(), numBins);
+            juce::FloatVectorOperations::add(sumSide.data(), other.sumSide.data(), numBins);
+            juce::FloatVectorOperations::add(sumStereo.data(), other.sumStereo.data(), numBins);
+            juce::FloatVectorOperations::max(peakMid.data(), peakMid.data(), other.peakMid.data(), numBins);
+            juce::FloatVectorOperations::max(peakSide.data(), peakSide.data(), other.peakSide.data(), numBins);
+            juce::FloatVectorOperations::max(peakStereo.data(), peakStereo.data(), other.peakStereo.data(), numBins);
+
+            numFrames += other.numFrames;
+        }
+    };
+
+    // Everything one thread needs to transform frames: its own FFT engine, window table and scratch
+    struct FrameKernel
+    {
+        FrameKernel() : forwardFFT(fftOrder), halfWindow((size_t)fftSize, 0.5f), midData((size_t)fftSize * 2, 0.0f), sideData((size_t)fftSize * 2, 0.0f)
+        {
+            // The mid/side factor of 0.5 is folded into the window, so a frame is built in one multiply per sample
+            juce::dsp::WindowingFunction<float>(fftSize, juce::dsp::WindowingFunction<float>::hann).multiplyWithWindowingTable(halfWindow.data(), (size_t)fftSize);
+        }
+
+        juce::dsp::FFT forwardFFT;
+        std::vector<float> halfWindow;
+        std::vector<float> midData, sideData;
+
+        // One frame: windowed mid/side in a single pass over the channel pointers, one real-input FFT per
+        // signal (none for the side of a mono file, which is silent), then power accumulation in vector ops
+        void accumulateFrame(const float* left, const float* right, PowerAccumulator& acc)
+        {
+            float* mid = midData.data();
+            float* side = sideData.data();
+            const float* w = halfWindow.data();
+
+            if (right != nullptr)
+            {
+                for (int j = 0; j < fftSize; ++j)
+                {
+                    mid[j] = (left[j] + right[j]) * w[j];
+                    side[j] = (left[j] - right[j]) * w[j];
+                }
+
+                forwardFFT.performRealOnlyForwardTransform(side, true);
+                computePower(side, acc.sidePower.data());
+            }
+            else
+            {
+                // With one channel mid is the channel itself, as the old per-sample path computed with r = l
+                for (int j = 0; j < fftSize; ++j)
+                {
+                    mid[j] = 2.0f * left[j] * w[j];
+                }
+
+                juce::FloatVectorOperations::clear(acc.sidePower.data(), numBins);
+            }
+
+            forwardFFT.performRealOnlyForwardTransform(mid, true);
+            computePower(mid, acc.midPower.data());
+
+            juce::FloatVectorOperations::add(acc.stereoPower.data(), acc.midPower.data(), acc.sidePower.data(), numBins);
+
+            juce::FloatVectorOperations::add(acc.sumMid.data(), acc.midPower.data(), numBins);
+            juce::FloatVectorOperations::add(acc.sumSide.data(), acc.sidePower.data(), numBins);
+            juce::FloatVectorOperations::add(acc.sumStereo.data(), acc.stereoPower.data(), numBins);
+            juce::FloatVectorOperations::max(acc.peakMid.data(), acc.peakMid.data(), acc.midPower.data(), numBins);
+            juce::FloatVectorOperations::max(acc.peakSide.data(), acc.peakSide.data(), acc.sidePower.data(), numBins);
+            juce::FloatVectorOperations::max(acc.peakStereo.data(), acc.peakStereo.data(), acc.stereoPower.data(), numBins);
+
+            acc.numFrames++;
+        }
+
+        // Squared magnitude of the interleaved bins, with the Hann amplitude correction of 2 applied as 4; DC is dropped
+        static void computePower(const float* spectrum, float* power)
+        {
+            const float windowCorrection = 4.0f;
+
+            for (int j = 0; j < numBins; ++j)
+            {
+                float re = spectrum[2 * j];
+                float im = spectrum[2 * j + 1];
+
+                power[j] = (re * re + im * im) * windowCorrection;
+            }
+
+            power[0] = 0.0f;
+        }
+    };
+
+    std::vector<std::unique_ptr<FrameKernel>> kernels;
+    std::vector<PowerAccumulator> slices;
+
+    std::unique_ptr<SpectrogramData> spectrogram;
+    std::vector<int> bandStart, bandEnd;
+    std::vector<float> bandOffsetDB;
+
+    // FFT bins of every spectrogram band, at least the nearest one where a band is narrower than a bin, and the
+    // dB offset that puts a band's power on the display scale, including its 4.5 dB per octave tilt
+    void buildBandTable()
+    {
+        const int numBands = SpectrogramData::numBands;
+        double binWidth = sampleRate / fftSize;
+        double ratio = SpectrogramData::maxFrequency / SpectrogramData::minFrequency;
+
+        bandStart.resize((size_t)numBands);
+        bandEnd.resize((size_t)numBands);
+        bandOffsetDB.resize((size_t)numBands);
+
+        for (int band = 0; band < numBands; ++band)
+        {
+            double low = SpectrogramData::minFrequency * std::pow(ratio, (double)band / numBands);
+            double high = SpectrogramData::minFrequency * std::pow(ratio, (double)(band + 1) / numBands);
+            double centre = std::sqrt(low * high);
+
+            int start = juce::jmax(1, juce::roundToInt(low / binWidth));
+            int end = juce::jmax(start + 1, juce::roundToInt(high / binWidth));
+
+            // Bands above Nyquist stay empty
+            bandStart[(size_t)band] = juce::jmin(start, numBins);
+            bandEnd[(size_t)band] = juce::jmin(end, numBins);
+            bandOffsetDB[(size_t)band] = 4.5f * (float)std::log2(centre / 1000.0) + 3.0f - juce::Decibels::gainToDecibels((float)fftSize);
+        }
+    }
+
+    // Peak power of each band, so a narrow resonance is not averaged away in the wide bands at the top
+    void writeColumn(const float* power, juce::uint8* column) const
+    {
+        for (size_t band = 0; band < bandStart.size(); ++band)
+        {
+            int start = bandStart[band];
+            int count = bandEnd[band] - start;
+
+            if (count <= 0)
+            {
+                column[band] = 0;
+
+                continue;
+            }
+
+            float peak = juce::FloatVectorOperations::findMaximum(power + start, count);
+
+            column[band] = SpectrogramData::dbToLevel(10.0f * std::log10(juce::jmax(peak, 1e-20f)) + bandOffsetDB[band]);
+        }
+    }
+
+    // Every complete frame in the pending window, split into one contiguous slice per kernel; the samples
+    // the next frame still needs are moved to the front
+    void transformPendingFrames()
+    {
+        int numFrames = numPendingSamples >= fftSize ? (numPendingSamples - fftSize) / hopSize + 1 : 0;
+
+        if (numFrames == 0) return;
+
+        const float* left = pending.getReadPointer(0);
+        const float* right = isStereo ? pending.getReadPointer(1) : nullptr;
+
+        juce::uint8* columns = nullptr;
+
+        // Frames land in their own columns, so the slices can fill them in any order
+        if (spectrogram != nullptr)
+        {
+            spectrogram->levels.resize((size_t)(spectrogram->numColumns + numFrames) * SpectrogramData::numBands);
+            columns = spectrogram->levels.data() + (size_t)spectrogram->numColumns * SpectrogramData::numBands;
+            spectrogram->numColumns += numFrames;
+        }
+
+        int numSlices = juce::jmin(numFrames, (int)kernels.size());
+        std::atomic<int> numRunning { numSlices };
+
+        for (int slice = 0; slice < numSlices; ++slice)
+        {
+            int firstFrame = numFrames * slice / numSlices;
+            int endFrame = numFrames * (slice + 1) / numSlices;
+
+            pool->submit([&, slice, firstFrame, endFrame]
+            {
+                for (int frame = firstFrame; frame < endFrame; ++frame)
+                {
+                    int start = frame * hopSize;
+
+                    kernels[(size_t)slice]->accumulateFrame(left + start, right != nullptr ? right + start : nullptr, slices[(size_t)slice]);
+
+                    if (columns != nullptr) writeColumn(slices[(size_t)slice].stereoPower.data(), columns + (size_t)frame * SpectrogramData::numBands);
+                }
+
+                numRunning--;
+            }, this);
+        }
+
+        pool->waitUntil([&numRunning] { return numRunning.load() == 0; }, this);
+
+        int consumed = numFrames * hopSize;
+
+        numPendingSamples -= consumed;
+
+        for (int ch = 0; ch < pending.getNumChannels(); ++ch)
+        {
+            auto* data = pending.getWritePointer(ch);
+
+            std::memmove(data, data + consumed, (size_t)numPendingSamples * sizeof(float));
+        }
+    }
+
+    static std::vector<float> calculateAverageMagnitude(const std::vector<float>& accumulated, int numBlocks)
+    {
+        std::vector<float> result(accumulated.size());
+
+        float norm = 1.0f / (float)numBlocks;
+
+        for (size_t i = 0; i < accumulated.size(); ++i)
+        {
+            result[i] = std::sqrt(accumulated[i] * norm);
+        }
+
+        return result;
+    }
+
+    static std::vector<float> calculatePeakMagnitude(const std::vector<float>& peakPower)
+    {
+        const float minMag = 1e-9f;
+
+        std::vector<float> result(peakPower.size());
+
+        for (size_t i = 0; i < peakPower.size(); ++i)
+        {
+            result[i] = std::max(minMag, std::sqrt(peakPower[i]));
+        }
+
+        return result;
+    }
+};
\ No newline at end of file
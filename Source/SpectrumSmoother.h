@@ -0,0 +1,89 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+
+// Fractional-octave smoothing in linear time. The averaging band of every bin only depends on the sample
+// rate, the FFT size and the octave fraction, so its edges are computed once per combination and shared by
+// all threads; each pass is then one prefix sum plus one subtraction per bin, whatever the band width.
+class SpectrumSmoother
+{
+public:
+
+    // Shared table for one combination; built on first use, thread-safe
+    static std::shared_ptr<const SpectrumSmoother> get(double sampleRate, int fftSize, float smoothingFactor)
+    {
+        static std::mutex mutex;
+        static std::map<std::tuple<double, int, float>, std::shared_ptr<const SpectrumSmoother>> tables;
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto& table = tables[std::make_tuple(sampleRate, fftSize, smoothingFactor)];
+
+        if (table == nullptr) table = std::make_shared<const SpectrumSmoother>(sampleRate, fftSize, smoothingFactor);
+
+        return table;
+    }
+
+    SpectrumSmoother(double sampleRate, int fftSize, float smoothingFactor)
+    {
+        int numBins = fftSize / 2;
+
+        lower.resize((size_t)numBins);
+        upper.resize((size_t)numBins);
+        scale.resize((size_t)numBins);
+
+        for (int i = 0; i < numBins; ++i)
+        {
+            float freq = (i * sampleRate) / fftSize;
+            float bandwidth = freq * smoothingFactor;
+
+            if (bandwidth < 10.0f) bandwidth = 10.0f;
+
+            int radius = (int)((bandwidth / sampleRate) * fftSize * 0.5f);
+
+            if (radius < 1) radius = 1;
+
+            // The band stays centred on the bin, so it narrows towards both ends of the spectrum
+            radius = std::min({ radius, i, (numBins - 1) - i });
+
+            lower[(size_t)i] = i - radius;
+            upper[(size_t)i] = i + radius + 1;
+            scale[(size_t)i] = 1.0f / (float)(2 * radius + 1);
+        }
+    }
+
+    // Two box passes over the magnitudes; data must hold fftSize / 2 bins
+    void apply(std::vector<float>& data) const
+    {
+        if (data.size() != lower.size()) return;
+
+        std::vector<double> prefix(data.size() + 1);
+
+        singlePass(data, prefix);
+        singlePass(data, prefix);
+    }
+
+private:
+
+    std::vector<int> lower, upper;
+    std::vector<float> scale;
+
+    void singlePass(std::vector<float>& data, std::vector<double>& prefix) const
+    {
+        prefix[0] = 0.0;
+
+        for (size_t i = 0; i < data.size(); ++i)
+        {
+            prefix[i + 1] = prefix[i] + data[i];
+        }
+
+        for (size_t i = 0; i < data.size(); ++i)
+        {
+            data[i] = (float)(prefix[(size_t)upper[i]] - prefix[(size_t)lower[i]]) * scale[i];
+        }
+    }
+};
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+
+struct TrackAnalysisData
+{
+    // Duration
+    double durationInSeconds = 0.0;
+    double sampleRate = 0.0;
+
+    // BPM
+    double bpm = 0.0;
+    double bpmConfidence = 0.0;
+
+    // Key & Camelot
+    juce::String musicalKey = "Unknown";
+    double keyConfidence = 0.0;
+    juce::String camelotKey = "Unknown";
+
+    // Loudness
+    double integratedLUFS = -100.0;
+    double shortTermMaxLUFS = -100.0;
+    double momentaryMaxLUFS = -100.0;
+    double loudnessRange = 0.0;
+    double averageDynamicsPLR = 0.0;
+    double truePeakMax = -100.0;
+
+    // Decoding
+    bool usedMemoryMappedReader = false;
+    juce::int64 bytesReadFromMapping = 0;
+    juce::int64 reusedBlockBytes = 0;
+
+    // Result Cache
+    bool loadedFromCache = false;
+
+    // Elapsed Time
+    double timeCacheLookup = 0.0;
+    double timeMemoryMapping = 0.0;
+    double timeAudioLoading = 0.0;
+    double timeLoudnessAnalysis = 0.0;
+    double timeBpmPrep = 0.0;
+    double timeBpmEssentia = 0.0;
+    double timeKeyPrep = 0.0;
+    double timeKeyEssentia = 0.0;
+    double timeSpectrumCalc = 0.0;
+    double timeTotal = 0.0;
+    
+    juce::String getFormattedDuration() const
+    {
+        if (durationInSeconds <= 0) return "00:00";
+
+        int minutes = (int)durationInSeconds / 60;
+        int seconds = (int)durationInSeconds % 60;
+
+        return juce::String::formatted("%02d:%02d", minutes, seconds);
+    }
+};
+
+// Time-frequency view of a whole track: one column per STFT frame, holding the stereo level of each
+// log-spaced band from 20 Hz to 20 kHz in the tilted dB scale of the spectrum display, in 0.5 dB steps
+struct SpectrogramData
+{
+    static constexpr int numBands = 256;
+    static constexpr float minFrequency = 20.0f;
+    static constexpr float maxFrequency = 20000.0f;
+    static constexpr float minDB = -120.0f;
+    static constexpr float dbPerStep = 0.5f;
+
+    double sampleRate = 0.0;
+    int hopSize = 0;
+    int numColumns = 0;
+
+    // numBands levels per column, lowest band first, one column after the other
+    std::vector<juce::uint8> levels;
+
+    bool isEmpty() const { return numColumns == 0 || sampleRate <= 0; }
+
+    double getSecondsPerColumn() const { return sampleRate > 0 ? hopSize / sampleRate : 0.0; }
+
+    const juce::uint8* getColumn(int column) const { return levels.data() + (size_t)column * numBands; }
+
+    static juce::uint8 dbToLevel(float db) { return (juce::uint8)juce::jlimit(0, 255, juce::roundToInt((db - minDB) / dbPerStep)); }
+
+    static float levelToDB(juce::uint8 level) { return minDB + level * dbPerStep; }
+};
+
+struct SpectrumData
+{
+    // Raw (unsmoothed) magnitudes per FFT bin
+    std::vector<float> avgMid, avgSide, avgStereo;
+    std::vector<float> maxMid, maxSide, maxStereo;
+    double sampleRate = 0.0;
+
+    // Full-track analyses only; shared between copies, since it is never modified once built
+    std::shared_ptr<const SpectrogramData> spectrogram;
+
+    bool isEmpty() const { return avgStereo.empty() || sampleRate <= 0; }
+};
\ No newline at end of file